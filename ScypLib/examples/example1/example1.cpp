@@ -23,6 +23,7 @@ int main()
     sl::Texture* texture = gfx.LoadTexture("knight.png");
     sl::Sound* sound = audio.LoadSound("hit.wav");
     sl::Shader* shader = gfx.LoadShader("plasma.vert", "plasma.frag", true);
+    sl::UniformHandle timeUniform = shader->GetUniform("uTime");
 
     // Setup sprite
     sl::Sprite sprite(texture);
@@ -54,7 +55,7 @@ int main()
             audio.PlaySound(sound);
 
         // Update shader uniform
-        shader->SetUniform1f("uTime", glfwGetTime() * 5);
+        shader->SetUniform(timeUniform, float(glfwGetTime() * 5));
 
         // Rendering
         gfx.BeginFrame();
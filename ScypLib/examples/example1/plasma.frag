@@ -5,7 +5,7 @@ in float vTexSlot;
 in vec4 vColorTint;
 
 out vec4 FragColor;
-uniform sampler2D uTextures[32];
+uniform sampler2D uTextures[28];
 uniform float uTime;
 
 void main()
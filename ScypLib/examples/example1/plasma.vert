@@ -1,15 +1,15 @@
 #version 450 core
 
-layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec2 aTexCoord;
-layout(location = 2) in float aInstanceIndex;
-
 struct InstanceData 
 {
-    mat4 transform;
-    vec4 colorTint;
-    float textureSlot;
-    float padding[3];
+    vec2 position;
+    vec2 size;
+    vec2 origin;
+    uint rotation;
+    float layer;
+    uint color;
+    uint textureSlot;
+    uvec2 uv;
 };
 
 layout(std140, binding = 0) uniform CameraBuffer 
@@ -18,21 +18,39 @@ layout(std140, binding = 0) uniform CameraBuffer
     mat4 projection;
 };
 
-layout(std430, binding = 1)readonly buffer instanceData
+layout(std430, binding = 1) readonly buffer instanceData
 {
     InstanceData instances[];
 };
 
+layout(std430, binding = 2) readonly buffer transformData
+{
+    mat4 transforms[];
+};
+
 out vec2 vTexCoord;
 out float vTexSlot;
 out vec4 vColorTint;
 
+const vec2 corners[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
 void main()
 {
-    InstanceData data = instances[int(aInstanceIndex)];
-    gl_Position = projection * view * data.transform * vec4(aPosition, 1.0);
+    InstanceData data = instances[gl_VertexID >> 2];
+    vec2 corner = corners[gl_VertexID & 3];
+    vec2 rotation = unpackSnorm2x16(data.rotation);
+    vec2 local = corner * data.size - data.origin;
+    vec2 position = data.position + data.origin + vec2(rotation.y * local.x - rotation.x * local.y, rotation.x * local.x + rotation.y * local.y);
+    vec4 world = vec4(position, data.layer, 1.0);
+
+    uint transformIndex = (data.textureSlot >> 16) & 0x7FFFu;
+    if (transformIndex != 0u) world = transforms[transformIndex - 1u] * world;
+    gl_Position = projection * view * world;
 
-    vTexCoord = aTexCoord;
-    vTexSlot = data.textureSlot;
-    vColorTint = data.colorTint;
+    bool halfUV = (data.textureSlot & 0x80000000u) != 0u;
+    vec2 uvX = halfUV ? unpackHalf2x16(data.uv.x) : unpackUnorm2x16(data.uv.x);
+    vec2 uvY = halfUV ? unpackHalf2x16(data.uv.y) : unpackUnorm2x16(data.uv.y);
+    vTexCoord = vec2(mix(uvX.x, uvX.y, corner.x), mix(uvY.y, uvY.x, corner.y));
+    vTexSlot = float(data.textureSlot & 0xFFFFu);
+    vColorTint = unpackUnorm4x8(data.color);
 }
\ No newline at end of file
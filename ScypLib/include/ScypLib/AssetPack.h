@@ -0,0 +1,71 @@
+#pragma once
+#include<string>
+#include<string_view>
+#include<vector>
+
+#include"MappedFile.h"
+
+namespace sl
+{
+	//read only archive of many assets in one memory mapped file
+	//the index is sorted by path for a binary search, every entry starts at its own alignment and is stored raw or zlib compressed
+	class AssetPack
+	{
+	public:
+		//bytes of one asset, points into the mapping when stored raw and owns the inflated or loose file copy otherwise
+		class Asset
+		{
+		public:
+			const unsigned char* GetData() const { return data; }
+			size_t GetSize() const { return size; }
+			bool IsValid() const { return data != nullptr; }
+			bool IsMapped() const { return data != nullptr && owned.empty(); }
+		private:
+			friend class AssetPack;
+
+			const unsigned char* data = nullptr;
+			size_t size = 0;
+			std::vector<unsigned char> owned;
+		};
+
+		//one file for Build, name is the path used to look it up later
+		struct Source
+		{
+			std::string path;
+			std::string name;
+			size_t alignment = 16;//power of two, 4096 lets an entry start on its own page
+			bool compress = false;//kept raw when deflate saves less than an eighth
+		};
+	public:
+		AssetPack() = default;
+		AssetPack(const std::string& path);
+
+		bool Open(const std::string& path);
+		void Close();
+		bool IsOpen() const { return file.IsOpen(); }
+
+		//paths are matched with '/' separators and without a leading "./"
+		bool Contains(std::string_view path) const;
+		//thread safe, raw entries are zero copy
+		bool Read(std::string_view path, Asset& asset) const;
+		size_t GetEntryCount() const { return entryCount; }
+
+		//resolves path through pack when it holds it, otherwise reads the loose file, pack may be nullptr
+		static bool Load(const AssetPack* pack, const std::string& path, Asset& asset);
+		//offline packer, entries are written in index order so loading them in path order reads the file front to back
+		static bool Build(const std::string& packPath, const std::vector<Source>& sources);
+		//zlib stream with the fixed huffman codes, also what png image data is stored as
+		static std::vector<unsigned char> Deflate(const unsigned char* data, size_t size);
+	private:
+		struct Entry;
+
+		const Entry* Find(std::string_view path) const;
+		std::string_view GetName(const Entry& entry) const;
+		static std::string Normalize(std::string_view path);
+	private:
+		MappedFile file;
+		const Entry* entries = nullptr;
+		size_t entryCount = 0;
+		const char* names = nullptr;
+	};
+}
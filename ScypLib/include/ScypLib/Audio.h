@@ -6,18 +6,25 @@
 #include<miniaudio/miniaudio.h>
 #undef PlaySound
 
+#include"AssetPack.h"
+
 namespace sl
 {
     class Sound
     {
     public:
         Sound(ma_engine* engine, const std::string& filepath);
+        //decodes from memory, asset is kept for the sound's lifetime
+        Sound(ma_engine* engine, AssetPack::Asset&& asset, const std::string& filepath);
         ~Sound();
+    private:
+        void Init(ma_engine* engine, const std::string& filepath);
     private:
         friend class Audio;
 
         ma_sound sound;
         ma_decoder decoder;
+        AssetPack::Asset asset;
     };
 
     class Audio
@@ -30,8 +37,11 @@ namespace sl
         void PlaySound(Sound* sound);
         void StopSound(Sound* sound);
         void ClearSounds();
+        //packed sounds are decoded from the mapping, the pack is not owned and must outlive them
+        void SetAssetPack(const AssetPack* pack) { assetPack = pack; }
     private:
         ma_engine soundEngine;
+        const AssetPack* assetPack = nullptr;
         std::unordered_map<std::string, std::unique_ptr<Sound>> sounds;
     };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include<string>
+#include<vector>
+#include<memory>
+#include<unordered_map>
+
+#include"stb/stb_truetype.h"
+
+#include"Rect.h"
+#include"Texture.h"
+#include"LRU.h"
+
+namespace sl
+{
+	//rasterizes glyphs on first use into shelf packed atlas pages, keyed by (codepoint, pixel size)
+	//when every page is full the least recently used page not touched this frame is cleared and reused
+	//in signed distance field mode every glyph is stored once at a reference size and serves all sizes and zoom levels
+	class DynamicFont
+	{
+		friend class Graphics;
+	public:
+		//offset is from the pen position on the baseline to the top left of the quad, in pixels
+		struct Glyph
+		{
+			const Texture* page = nullptr;
+			RectF uv = { 0.0f, 0.0f, 0.0f, 0.0f };
+			Vec2f offset = { 0.0f, 0.0f };
+			Vec2f size = { 0.0f, 0.0f };
+			float advance = 0.0f;
+			int pageIndex = -1;
+		};
+	private:
+		struct Shelf
+		{
+			int y;
+			int height;
+			int x;
+		};
+		struct Page
+		{
+			std::unique_ptr<Texture> texture;
+			std::vector<Shelf> shelves;
+			int nextShelfY = 0;
+			std::vector<unsigned long long> keys;//glyphs stored in the page, dropped together on eviction
+			size_t lastUsedFrame = 0;
+		};
+	public:
+		DynamicFont(std::vector<unsigned char>&& ttfBuffer, int pageSize = 1024, int maxPages = 4, bool signedDistanceField = false);
+		DynamicFont(const DynamicFont&) = delete;
+		DynamicFont& operator=(const DynamicFont&) = delete;
+
+		//nullptr when the glyph does not fit any page this frame, metrics have to be multiplied by GetGlyphScale
+		const Glyph* GetGlyph(unsigned int codepoint, int pixelSize);
+		float GetGlyphScale(int pixelSize) const { return signedDistanceField ? float(pixelSize) / float(sdfPixelSize) : 1.0f; }
+		float GetKerning(unsigned int left, unsigned int right, int pixelSize) const;
+		float GetAscent(int pixelSize) const;
+		float GetLineHeight(int pixelSize) const;
+
+		size_t GetGlyphCount() const { return glyphs.size(); }
+		size_t GetPageCount() const { return pages.size(); }
+		size_t GetEvictions() const { return evictions; }
+		bool IsSignedDistanceField() const { return signedDistanceField; }
+		const Texture* GetPage(size_t index) const { return pages[index].texture.get(); }
+
+		//decodes the utf-8 sequence at index and advances past it, invalid bytes decode as U+FFFD
+		static unsigned int NextCodepoint(const std::string& text, size_t& index);
+	private:
+		void NextFrame() { frameIndex++; }
+		const Glyph* Rasterize(unsigned long long key, unsigned int codepoint, int pixelSize);
+		bool Allocate(Page& page, int width, int height, int& x, int& y);
+		int AddPage();
+		int EvictPage();
+	private:
+		std::vector<unsigned char> ttfBuffer;
+		stbtt_fontinfo info{};
+		int ascent = 0;
+		int descent = 0;
+		int lineGap = 0;
+		int pageSize = 1024;
+		int maxPages = 4;
+		int padding = 1;
+		bool signedDistanceField = false;
+		int sdfPixelSize = 48;
+		int sdfSpread = 6;//pixels of distance stored around the outline
+		std::vector<Page> pages;
+		LRU<int> pageLRU;
+		std::unordered_map<unsigned long long, Glyph> glyphs;
+		std::vector<unsigned char> rasterBuffer;
+		std::vector<unsigned char> uploadBuffer;
+		size_t frameIndex = 1;
+		size_t evictions = 0;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include<string>
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+
+#include"PixelReadback.h"
+
+namespace sl
+{
+	enum class FrameFormat
+	{
+		Raw,//binary pam, a short text header and the rgba8 rows as they are
+		Png//rows deflated on the writer thread, smaller files at some cpu cost
+	};
+
+	//streams canvas frames to numbered files in a directory, set on Graphics to capture every EndFrame
+	//frames are copied into a pixel pack buffer ring, collected once their fence has signalled and written on a background thread
+	//a frame the gpu or the writer could not keep up with is dropped and counted, the file numbers then show the gap
+	class FrameRecorder
+	{
+	public:
+		//latency is how many frames a copy may stay in flight before its slot is needed again
+		//maxQueuedFrames bounds the frames waiting for the writer, each holds a full copy of the canvas
+		FrameRecorder(const std::string& directory, FrameFormat format = FrameFormat::Png, int latency = 2, size_t maxQueuedFrames = 8);
+		FrameRecorder(const FrameRecorder&) = delete;
+		FrameRecorder& operator=(const FrameRecorder&) = delete;
+		//waits for the copies still in flight and the writer, needs the gl context
+		~FrameRecorder();
+
+		//render thread, called by Graphics::EndFrame with the canvas framebuffer
+		void Capture(unsigned int framebuffer, int width, int height);
+		//stops capturing until Resume, frames already captured are still written
+		void Pause() { paused = true; }
+		void Resume() { paused = false; }
+		bool IsPaused() const { return paused; }
+
+		size_t GetCapturedFrames() const { return frameNumber; }
+		size_t GetDroppedFrames() const;
+		size_t GetWrittenFrames() const;
+		size_t GetFailedWrites() const;
+	private:
+		struct Frame
+		{
+			size_t number = 0;
+			PixelRegion pixels;
+		};
+		struct Pending
+		{
+			size_t number;
+			ReadbackTicket ticket;
+		};
+
+		void CollectFrames(bool wait);
+		void WriterLoop();
+		bool WriteFrame(const Frame& frame, std::vector<unsigned char>& scratch) const;
+	private:
+		std::string directory;
+		FrameFormat format;
+		size_t maxQueuedFrames;
+		bool paused = false;
+		size_t frameNumber = 0;
+		//render thread only
+		PixelReadback readback;
+		std::deque<Pending> pending;
+		//shared with the writer
+		mutable std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Frame> queue;
+		std::vector<PixelRegion> freeFrames;//written frames keep their capacity for the next collect
+		bool stopping = false;
+		size_t dropped = 0;
+		size_t written = 0;
+		size_t failed = 0;
+		std::thread writer;
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include<unordered_map>
 #include<unordered_set>
+#include<string_view>
+#include<functional>
 
 #include<glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
@@ -12,11 +14,31 @@
 #include"Sprite.h"
 #include"Shader.h"
 #include"Texture.h"
+#include"TextureArray.h"
+#include"TextureAtlas.h"
+#include"TextureLoader.h"
+#include"AssetPack.h"
+#include"Tilemap.h"
+#include"SpriteBatch.h"
 #include"Font.h"
+#include"DynamicFont.h"
+#include"StreamBuffer.h"
+#include"RenderQueue.h"
+#include"RenderTargetPool.h"
+#include"PixelReadback.h"
+#include"FrameRecorder.h"
 #undef DrawText
 
 namespace sl
 {
+    //how EndFrame fits the canvas into the window
+    enum class PresentScaling
+    {
+        Stretch,//fills the window, the default
+        Letterbox,//largest size that keeps the aspect ratio, centered with black bars
+        Integer//largest whole multiple of the canvas size, falls back to Letterbox when the window is smaller than the canvas
+    };
+
     class Graphics
     {
     private:
@@ -25,72 +47,196 @@ namespace sl
             alignas(16) glm::mat4 view;
             alignas(16) glm::mat4 projection;
         };
-        struct TextureVertex
-        {
-            float x, y, z;
-            float u, v;
-            float instanceIndex;
-
-            TextureVertex(float x, float y, float z, float u, float v, int instanceIndex);
-
-            bool operator==(const TextureVertex& other) const;
-
-            struct Hasher
-            {
-                size_t operator()(const TextureVertex& vertex) const;
-            };
-        };
-        struct InstanceData
+        struct TextRun;
+        struct AsyncLoad
         {
-        public:
-            InstanceData(glm::mat4 transform, Color color, float textureSlot);
-        public:
-            alignas(16) glm::mat4 transform;
-            alignas(16) Color color;
-            alignas(16) float textureSlot;
+            Texture* texture;
+            std::vector<std::function<void(Texture*)>> callbacks;
         };
         struct Renderable
         {
         public:
-            Renderable(float x, float y, float z, float width, float height, RectF uv, const Texture* texture, glm::mat4 transform, Color color);
+            Renderable(float x, float y, float z, float width, float height, RectF uv, const Texture* texture, Shader* shader, Color color, float angle = 0.0f, Vec2f origin = Vec2f(0.0f, 0.0f));
         public:
             float x, y, z = 0;
             float width, height;
+            float angle;//radians, around pos + origin
+            Vec2f origin;
             const Texture* texture;
-            InstanceData data;
+            Shader* shader;
+            Color color;
             RectF uv;
+            int transformIndex = -1;//into frameTransforms, only set for arbitrary transforms
+            Tilemap* tilemap = nullptr;//set for tilemap chunks, drawn from the chunk buffer instead of the instance stream
+            int chunkIndex = -1;
+            SpriteBatch* spriteBatch = nullptr;//set for retained batches, drawn from the batch buffer
+            const TextRun* textRun = nullptr;//set for cached text, expanded into one instance per glyph
+        };
+        //glyph quad laid out relative to the top left of its run, uv is normalized
+        struct Glyph
+        {
+            Vec2f pos;
+            Vec2f size;
+            RectF uv;
+        };
+        struct TextRun
+        {
+            std::string text;
+            RectF bounds = { 0.0f, 0.0f, 0.0f, 0.0f };//relative to the DrawText position
+            std::vector<Glyph> glyphs;
+            size_t lastUsedFrame = 0;
+        };
+        struct TextRunKey
+        {
+            const Font* font;
+            size_t textHash;
+            float height;
+            bool operator==(const TextRunKey& other) const
+            {
+                return font == other.font && textHash == other.textHash && height == other.height;
+            }
+        };
+        struct TextRunKeyHasher
+        {
+            size_t operator()(const TextRunKey& key) const
+            {
+                size_t h = std::hash<const Font*>()(key.font);
+                h ^= key.textHash + 0x9e3779b9 + (h << 6) + (h >> 2);
+                h ^= std::hash<float>()(key.height) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+        //48 bytes, the vertex shader rebuilds the affine transform from position, origin and rotation
+        struct InstanceData
+        {
+        public:
+            InstanceData(const Renderable& renderable, int textureSlot, int transformIndex);
+        public:
+            glm::vec2 position;
+            glm::vec2 size;
+            glm::vec2 origin;
+            unsigned int rotation;//sin, cos as snorm16
+            float layer;
+            unsigned int color;//rgba8
+            unsigned int textureSlot;//slot in the low 16 bits, transform index + 1 in bits 16-30, bit 31 marks half float uvs
+            unsigned int uv[2];//left, right and top, bottom as unorm16, as halves when the rect leaves 0-1 so repeat wrapping still tiles
+        };
+    public:
+        struct RenderStats
+        {
+            //per frame, reset in BeginFrame
+            size_t submitted = 0;
+            size_t flushes = 0;
+            size_t drawCalls = 0;
+            //shader breaks and texture switches avoided by sorting, compared to submission order
+            size_t flushesSaved = 0;
+            size_t textureChangesSaved = 0;
+            //renderables skipped by view culling and renderables uploaded
+            size_t culled = 0;
+            size_t drawn = 0;
+            //tilemap chunks drawn from their own buffers and chunks rebuilt because tiles or baked state changed
+            size_t tilemapChunks = 0;
+            size_t tilemapChunkRebuilds = 0;
+            //retained sprite batches drawn and sprite records re-uploaded for them
+            size_t spriteBatches = 0;
+            size_t spriteBatchUploads = 0;
+            //DrawText calls served from the glyph run cache and calls that had to lay the string out
+            size_t textRunHits = 0;
+            size_t textRunMisses = 0;
+            //heap allocations made by the command buffers, 0 once capacity has settled
+            size_t commandBufferGrowths = 0;
+            //times the cpu had to wait for the gpu to release a streaming region, cumulative
+            size_t streamStalls = 0;
+            //pixel readbacks overwritten before they were collected, cumulative
+            size_t readbacksDropped = 0;
         };
     public:
         Graphics(Window* wnd);
-        Graphics(Window* wnd, float canvasWidth, float canvasHeight);
+        //a shader cache directory lets the built-in shaders load from cached binaries as well
+        Graphics(Window* wnd, float canvasWidth, float canvasHeight, const std::string& shaderCacheDirectory = "");
         ~Graphics();
 
         void BeginFrame();
+        //without a shader the canvas is copied to the window with one framebuffer blit, a shader draws it as a textured quad
         void EndFrame(Shader* shader = nullptr);
         void EndFrame(std::vector<Shader*>& shaders);
         void BeginView(Vec2f cameraPosition = { 0.0f, 0.0f }, float zoom = 1.0f);
         void EndView(std::vector<Shader*>& shaders);
         void EndView(Shader* shader = nullptr);
         void SetDrawLayer(float layer);
+        //skips renderables outside the BeginView rect, on by default
+        void SetCulling(bool enabled);
         void SetCanvasSize(Vec2f size);
         void SetCanvasWidth(float width);
         void SetCanvasHeight(float height);
+        //color format of the canvas and its post processing ping pong texture, RGBA8 by default
+        void SetCanvasFormat(TextureFormat format);
+        //without a depth buffer every draw is sorted back to front and blended as needed, layers then only order through the sort
+        //saves the depth clear and depth traffic in scenes that do not need it, call it with no draws queued, e.g. before BeginFrame
+        void SetCanvasDepth(bool enabled);
+        void SetPresentScaling(PresentScaling scaling);
+        PresentScaling GetPresentScaling() const { return presentScaling; }
         void SetVSyncInterval(int interval);
+        void SetStreamingBuffers(bool enabled, int regionCount = 3);
         void ApplyPostProcessing(std::vector<Shader*>& shaders);
+        //runs the passes over the canvas after the queued draws, each as one full screen triangle with no batch traffic
+        //a pass samples the previous output as uSource and the canvas before the chain as uScene, uTexelSize is 1 / source size
+        //intermediate outputs come from a pool of render targets reused across frames, the last pass writes the canvas
+        void ApplyPostProcessing(const std::vector<PostProcessPass>& passes);
+        //gpu time of each pass in milliseconds, from the latest chain whose timer queries completed, so a few frames behind
+        const std::vector<float>& GetPostProcessTimings() const { return postProcessTimings; }
         void SetDefaultFont(Font* font);;
         void SetDefaultShader(Shader* shader);
+        //frames a cached text layout may go unused before it is dropped
+        void SetTextRunLifetime(size_t frames);
 
         Texture* LoadTexture(const std::string& filepath, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+        //loads the image into a shared GL_TEXTURE_2D_ARRAY page of the same size, drawing it needs no extra texture slot
+        Texture* LoadArrayTexture(const std::string& filepath, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+        //bytes of vram a new array page may reserve, mips included, a page always holds at least one layer
+        void SetTextureArrayPageBudget(size_t bytes);
+        //returns at once with a placeholder of the final size, the image is decoded on worker threads and uploaded in BeginFrame
+        //onLoaded runs on the render thread once the texture is ready, or still not ready when decoding failed
+        Texture* LoadTextureAsync(const std::string& filepath, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest,
+            TextureFilter magFilter = TextureFilter::Nearest, std::function<void(Texture*)> onLoaded = nullptr);
+        //decoded images are kept under directory and mapped on later loads, an empty directory turns the cache off
+        void SetTextureCache(const std::string& directory);
+        const TextureCache* GetTextureCache() const { return textureCache.get(); }
+        //linked programs are kept under directory and reused while the sources and driver match, an empty directory turns the cache off
+        void SetShaderCache(const std::string& directory);
+        const ShaderCache* GetShaderCache() const { return shaderCache.get(); }
+        //paths the pack holds are read from its mapping instead of loose files by the texture, font and shader loaders
+        //the pack is not owned and must stay open while loading from it
+        void SetAssetPack(const AssetPack* pack);
+        const AssetPack* GetAssetPack() const { return assetPack; }
+        //bytes of decoded pixels uploaded per frame, at least one image always goes through
+        void SetTextureUploadBudget(size_t bytes);
+        size_t GetPendingTextureLoads() const { return asyncLoads.size(); }
+        //packs the image into the atlas, the returned sub-texture draws like any other texture but shares the page's slot
+        Texture* LoadTexture(const std::string& filepath, TextureAtlas* atlas);
+        TextureAtlas* CreateTextureAtlas(int pageSize = 2048, int padding = 2, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+        //reclaims the space of removed images, tilemaps and sprite batches using the atlas bake uvs and need their tiles or sprites set again
+        void RepackTextureAtlas(TextureAtlas* atlas);
+        void UnloadTextureAtlas(TextureAtlas* atlas);
         Texture* CreateTextureFromMemory(int width, int height, int BPP, unsigned char* buffer, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter);
         Font* LoadFont(const std::string& filepath, char firstChar, char lastChar);
         void UnloadTexture(Texture* texture);
         void UnloadFont(Font* font);
+        //glyphs are rasterized on first use at the exact pixel size they are drawn with
+        //signedDistanceField stores each glyph once and draws it with the built-in sdf text shader at any size
+        DynamicFont* LoadDynamicFont(const std::string& filepath, int pageSize = 1024, int maxPages = 4, bool signedDistanceField = false);
+        void UnloadDynamicFont(DynamicFont* font);
         Shader* LoadShader(const std::string& vertex, const std::string& fragment, bool isPath);
+        //pairs the fragment shader with the built-in full screen triangle vertex shader, which outputs vTexCoord
+        Shader* LoadPostProcessShader(const std::string& fragment, bool isPath);
         void UnloadShader(Shader* shader);
+        //Shader::GetVariant with the texture sampler uniforms set up, the built-in shader's variants are picked automatically
+        Shader* GetShaderVariant(Shader* shader, unsigned int defines);
 
         void DrawTexture(float x, float y, const Texture* texture);
         void DrawTexture(Vec2f pos, Vec2f size, const Texture* texture, Shader* shader = nullptr, bool flipX = false, bool flipY = false, float angle = 0.0f, Vec2f origin = Vec2f(0.0f, 0.0f), const RectF* uv = nullptr, const Color& tint = Colors::White);
         void DrawTexture(const RectF& targetRect, const Texture* texture, Shader* shader = nullptr, bool flipX = false, bool flipY = false, float angle = 0.0f, Vec2f origin = Vec2f(0.0f, 0.0f), const RectF* uv = nullptr, const Color& tint = Colors::White);
+        void DrawTexture(const glm::mat4& transform, const RectF& targetRect, const Texture* texture, Shader* shader = nullptr, const RectF* uv = nullptr, const Color& tint = Colors::White);
         void DrawSprite(const Sprite& sprite);
         void DrawAnimatedSprite(const AnimatedSprite& animatedSprite);
         void DrawLine(float x1, float y1, float x2, float y2, float thickness, const Color& c, Shader* shader = nullptr);
@@ -99,10 +245,37 @@ namespace sl
         void DrawRect(Vec2f pos, Vec2f size, const Color& c, float angle, Shader* shader = nullptr);
         void DrawRect(const RectF& rect, const Color& c, float angle, Shader* shader = nullptr);
         void DrawText(float x, float y, const std::string& text, Font* font, float height, const Color& c);
+        //utf-8 text, y is the top of the line
+        void DrawText(float x, float y, const std::string& text, DynamicFont& font, int pixelSize, const Color& c);
+        //one draw per visible non empty chunk, at the current draw layer
+        void DrawTilemap(Tilemap& tilemap, Shader* shader = nullptr);
+        //draws every sprite of the batch at the current draw layer, only sprites changed since the last draw are uploaded
+        void DrawSpriteBatch(SpriteBatch& batch, Shader* shader = nullptr);
         void PutPixel(float x, float y, const Color& c);
 
+        //blocking read of one canvas pixel, x and y are canvas coordinates from the top left
         Color GetPixel(int x, int y);
+        //queues a copy of the canvas region as rendered so far, EndView and EndFrame render the queued draws
+        //collect the result a frame or two later, earlier calls just return false without waiting on the gpu
+        ReadbackTicket RequestPixels(const RectI& region);
+        ReadbackTicket RequestCanvasPixels();
+        bool IsPixelsReady(ReadbackTicket ticket) const { return readback.IsReady(ticket); }
+        bool CollectPixels(ReadbackTicket ticket, PixelRegion& pixels);
+        //synchronous copy of the region, stalls until the gpu catches up so keep it to tests and tools
+        //it bypasses the readback ring and never drops a pending ticket
+        PixelRegion ReadPixels(const RectI& region);
+        //readbacks that can be in flight at once, a request past that drops the oldest uncollected one
+        void SetReadbackSlots(int count);
+        //captures the canvas at every EndFrame until set to nullptr, the recorder is not owned
+        void SetFrameRecorder(FrameRecorder* recorder) { frameRecorder = recorder; }
+        FrameRecorder* GetFrameRecorder() const { return frameRecorder; }
         RectF GetCanvasRect()const;
+        //area of the window the canvas is presented to, in window pixels with the origin at the top left
+        RectI GetPresentRect()const;
+        RectF GetViewRect()const;
+        //maps a window position (e.g. Mouse::GetPos()) to world coordinates of the current view
+        Vec2f ScreenToWorld(const Vec2f& screenPos)const;
+        const RenderStats& GetRenderStats() const { return stats; }
         float GetCanvasWidth()const;
         float GetCanvasHeight()const;
     public:
@@ -114,33 +287,69 @@ namespace sl
         void BindVertexBuffer(unsigned int vbo);
     private:
         void UpdateCanvasSize(float width, float height);
+        void CreateCanvas();
+        void Present(Shader* shader);
+        Texture* CreateRenderTexture(int width, int height, TextureFormat format);
         void ClearBatchData();
+        void Submit(Renderable renderable, bool isOpaque);
+        void SetTextureUniforms(Shader* shader);
+        static bool IsVisible(const Renderable& renderable, const RectF& view);
+        uint64_t MakeSortKey(const Renderable& renderable, bool isOpaque) const;
         void Render();
         void FlushBatch();
         void UploadRenderable(Renderable* renderable);
+        void DrawTilemapChunk(const Renderable& renderable);
+        void DrawSpriteBatchInstances(const Renderable& renderable);
+        const TextRun* GetTextRun(const std::string& text, const Font* font, float height);
+        void ExpireTextRuns();
+        int GetRetainedTextureSlot(const Texture* texture);
+        void DrawRetainedInstances(unsigned int buffer, size_t count);
         int GetTextureSlot(const Texture* texture);
+        int GetTextureArraySlot(const TextureArray* array);
         const int GetTextureSlotLimit() const { return maxTextureSlots; };
         void BindTexture(const Texture* texture);
         void UseTexture(const Texture* texture);
         void ClearTextures();
+        void ReleaseTextureSlot(const Texture* texture);
+        void ProcessTextureUploads();
+        //stbi decode with the vertical flip, from the asset pack when it holds filepath
+        unsigned char* DecodeImage(const std::string& filepath, int& width, int& height, int& BPP) const;
     private:
         //window and canvasdata
         Window* window = nullptr;
         float canvasWidth = -1.0f;
         float canvasHeight = -1.0f;
         //framebuffer
-        unsigned int fbo;
-        unsigned int rbo;
+        unsigned int fbo = 0;
+        unsigned int rbo = 0;
+        TextureFormat canvasFormat = TextureFormat::RGBA8;
+        bool canvasDepth = true;
+        PresentScaling presentScaling = PresentScaling::Stretch;
+        bool viewPresentQueued = false;//EndView queued the canvas with a shader, it is drawn to the window in EndFrame
         Texture* framebufferTexture = nullptr;
         Texture* framebufferTextureSecondary = nullptr;
+        //post processing, inputs are bound to the units after the texture array pages
+        RenderTargetPool renderTargets;
+        unsigned int linearSampler = 0;
+        unsigned int nearestSampler = 0;
+        std::vector<std::vector<unsigned int>> postProcessQueries;//one set of timer queries per frame in flight
+        std::vector<size_t> postProcessQueryCounts;
+        std::vector<float> postProcessTimings;
+        //canvas readback
+        PixelReadback readback;
+        FrameRecorder* frameRecorder = nullptr;
         //others
         float curDrawLayer = 0;
+        Vec2f viewPosition = { 0.0f, 0.0f };
+        float viewZoom = 1.0f;
+        bool cullingEnabled = true;
         Texture* blankTexture = nullptr;
         unsigned int vpMatUbo = 0;
         unsigned int vpMatUboBindingPoint = 0;
         int totalDynamiclyCreatedTextures = 0;
         float fontLineHeight = 32;
         Shader* builtInShader = nullptr;
+        Shader* sdfTextShader = nullptr;
         Shader* defaultShader = nullptr;
         Font* defaultFont = nullptr;
         ViewProjMat vpMat{};
@@ -153,28 +362,57 @@ namespace sl
         unsigned int boundUBO = 0;
         //batch components
         Shader* currentShader = nullptr;
+        bool batchTinted = false;//any instance in the pending batch has a tint other than white
         unsigned int vao = 0;
-        unsigned int vbo = 0;
-        unsigned int ibo = 0;
+        unsigned int ibo = 0;//static quad pattern, corners are pulled from gl_VertexID
         unsigned int instanceSSBO = 0;
         unsigned int instanceSSBOBindingPoint = 1;
-        std::vector<unsigned int> indices;
-        std::vector<TextureVertex> vertices;
-        size_t maxQuadsInBatch = 10000;
+        unsigned int transformSSBO = 0;
+        unsigned int transformSSBOBindingPoint = 2;
+        //persistent mapped streaming path, replaces the glBufferSubData uploads when enabled
+        std::unique_ptr<StreamBuffer> streamBuffer;
+        int ssboOffsetAlignment = 16;
+        size_t maxQuadsInBatch = 10000;//below 0x7FFF, transform indices share InstanceData::textureSlot with the slot and the half uv flag
         std::vector<InstanceData> instanceDataBuffer;
-        std::unordered_set<const Texture*> usedTextures;
-        // renderables containers
-        std::unordered_map<Shader*, std::vector<std::unique_ptr<Renderable>>> opaque;
-        std::unordered_map<Shader*, std::vector<std::unique_ptr<Renderable>>> transparent;
+        std::vector<glm::mat4> transformBuffer;
+        std::vector<InstanceData> retainedInstanceBuffer;//scratch for tilemap chunk rebuilds and sprite batch uploads
+        std::vector<const Texture*> usedTextures;
+        // renderables container, flat command buffer that keeps its capacity between frames
+        RenderQueue<Renderable> renderQueue;
+        std::vector<glm::mat4> frameTransforms;
+        RenderStats stats;
         //texture manager
         int maxTextureSlots = 0;
+        int retainedTextureSlot = 0;//last 2d slot, bound per tilemap chunk draw and never handed out by the lru
         LRU<const Texture*> lru;
         std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
         std::unordered_map<const Texture*, int> textureToSlot;
         std::unordered_map<int, const Texture*> slotToTexture;
         std::unordered_set<int> availableSlots;
+        //texture array pages, bound to the units right after the 2d slots
+        std::vector<std::unique_ptr<TextureArray>> textureArrays;
+        std::vector<const TextureArray*> textureArraySlots;
+        int textureArraySlotCount = 4;
+        int textureArrayPageLayers = 256;//driver limit, pages are usually capped lower by textureArrayPageBudget
+        size_t textureArrayPageBudget = 64 * 1024 * 1024;
+        int nextTextureArraySlot = 0;
+        unsigned int usedTextureArraySlots = 0;
+        std::vector<std::unique_ptr<TextureAtlas>> textureAtlases;
+        //async loading, decoded on loader threads and uploaded through uploadPBO
+        std::unique_ptr<TextureCache> textureCache;
+        std::unique_ptr<TextureLoader> textureLoader;
+        std::unordered_map<unsigned long long, AsyncLoad> asyncLoads;
+        unsigned long long nextAsyncLoadId = 1;
+        size_t textureUploadBudget = 16 * 1024 * 1024;
+        unsigned int uploadPBO = 0;
+        const AssetPack* assetPack = nullptr;
+        std::unique_ptr<ShaderCache> shaderCache;
         //fonts
         std::unordered_map<std::string, std::unique_ptr<Font>> fonts;
+        std::unordered_map<std::string, std::unique_ptr<DynamicFont>> dynamicFonts;
+        std::unordered_map<TextRunKey, TextRun, TextRunKeyHasher> textRuns;
+        size_t textRunLifetime = 120;
+        size_t frameIndex = 0;
         //shaders
         std::unordered_map<std::string, std::unique_ptr<Shader>> shaders;
     };
@@ -12,7 +12,13 @@ namespace sl
 		LRU() = default;
 		void Push(T key)
 		{
-			Erase(key);
+			auto it = keyPos.find(key);
+			if (it != keyPos.end())
+			{
+				//relink the existing node instead of reallocating it
+				accessOrder.splice(accessOrder.end(), accessOrder, it->second);
+				return;
+			}
 			accessOrder.push_back(key);
 			keyPos[key] = std::prev(accessOrder.end());
 		}
@@ -0,0 +1,33 @@
+#pragma once
+#include<string>
+
+namespace sl
+{
+	//read only memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		~MappedFile();
+
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const { return data != nullptr; }
+		const unsigned char* GetData() const { return data; }
+		size_t GetSize() const { return size; }
+	private:
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int descriptor = -1;
+#endif
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include<vector>
+#include<cstdint>
+
+#include<GL/glew.h>
+
+#include"Color.h"
+
+namespace sl
+{
+	//identifies one pending readback, 0 is never handed out
+	using ReadbackTicket = uint64_t;
+
+	//rgba8 copy of a framebuffer region, rows run from the top of the region down
+	struct PixelRegion
+	{
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> pixels;
+
+		//x and y are relative to the region
+		Color GetPixel(int x, int y) const;
+	};
+
+	//ring of pixel pack buffers, glReadPixels writes into one and a fence tells when the copy has finished
+	//a request only queues the copy, collecting it a frame or two later maps a buffer the gpu is done with
+	class PixelReadback
+	{
+	public:
+		PixelReadback(int slotCount = 4);
+		PixelReadback(const PixelReadback&) = delete;
+		PixelReadback& operator=(const PixelReadback&) = delete;
+		~PixelReadback();
+
+		//y is measured from the top of the framebuffer like canvas coordinates
+		//reuses the oldest slot when every slot is pending, its ticket is dropped and can no longer be collected
+		ReadbackTicket Request(unsigned int framebuffer, int framebufferHeight, int x, int y, int width, int height);
+		bool IsReady(ReadbackTicket ticket) const;
+		//false while the copy is still in flight or when the ticket was dropped, the slot is freed once collected
+		bool Collect(ReadbackTicket ticket, PixelRegion& region);
+		//blocks until the copy has finished, false only for dropped tickets
+		bool Wait(ReadbackTicket ticket, PixelRegion& region);
+		//blocking copy straight into client memory, no slot is used so pending tickets are never dropped by it
+		static void Read(unsigned int framebuffer, int framebufferHeight, int x, int y, int width, int height, PixelRegion& region);
+		bool IsPending(ReadbackTicket ticket) const { return Find(ticket) != nullptr; }
+
+		//drops every pending ticket
+		void SetSlotCount(int count);
+		int GetSlotCount() const { return int(slots.size()); }
+		size_t GetDropped() const { return dropped; }
+	private:
+		struct Slot
+		{
+			unsigned int buffer = 0;
+			size_t capacity = 0;
+			GLsync fence = nullptr;
+			ReadbackTicket ticket = 0;
+			int x = 0;
+			int y = 0;
+			int width = 0;
+			int height = 0;
+		};
+
+		Slot* Find(ReadbackTicket ticket);
+		const Slot* Find(ReadbackTicket ticket) const;
+		static void Release(Slot& slot);
+		static void Destroy(Slot& slot);
+	private:
+		std::vector<Slot> slots;
+		size_t next = 0;
+		ReadbackTicket lastTicket = 0;
+		size_t dropped = 0;
+	};
+}
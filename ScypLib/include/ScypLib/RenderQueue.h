@@ -0,0 +1,91 @@
+#pragma once
+#include<vector>
+#include<cstdint>
+#include<cstring>
+#include<cassert>
+
+namespace sl
+{
+	//flat queue of items tagged with a 64-bit sort key, ordered by a stable LSD radix sort
+	template<typename T>
+	class RenderQueue
+	{
+	private:
+		struct Entry
+		{
+			uint64_t key;
+			unsigned int index;
+		};
+	public:
+		RenderQueue() = default;
+		void Reserve(size_t size)
+		{
+			items.reserve(size);
+			entries.reserve(size);
+			scratch.reserve(size);
+		}
+		//returns true when the push had to grow the queue
+		bool Push(uint64_t key, const T& item)
+		{
+			bool grew = items.size() == items.capacity();
+			entries.push_back({ key, static_cast<unsigned int>(items.size()) });
+			items.push_back(item);
+			return grew;
+		}
+		void Sort()
+		{
+			if (entries.empty()) return;
+			scratch.resize(entries.size());
+			Entry* src = entries.data();
+			Entry* dst = scratch.data();
+			size_t count = entries.size();
+			for (int shift = 0; shift < 64; shift += 8)
+			{
+				size_t histogram[256]{};
+				for (size_t i = 0; i < count; i++) histogram[(src[i].key >> shift) & 0xFF]++;
+				//every key shares this byte, the pass would not move anything
+				if (histogram[(src[0].key >> shift) & 0xFF] == count) continue;
+
+				size_t offset = 0;
+				for (size_t& bucket : histogram)
+				{
+					size_t bucketSize = bucket;
+					bucket = offset;
+					offset += bucketSize;
+				}
+				for (size_t i = 0; i < count; i++) dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+				std::swap(src, dst);
+			}
+			if (src != entries.data()) memcpy(entries.data(), src, count * sizeof(Entry));
+		}
+		//drops entries whose item fails the predicate, returns how many were removed
+		template<typename Predicate>
+		size_t KeepIf(Predicate predicate)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				if (predicate(items[entries[i].index])) entries[kept++] = entries[i];
+			}
+			size_t removed = entries.size() - kept;
+			entries.resize(kept);
+			return removed;
+		}
+		void Clear()
+		{
+			items.clear();
+			entries.clear();
+		}
+
+		bool IsEmpty() const { return entries.empty(); }
+		size_t GetSize() const { return entries.size(); }
+		uint64_t GetKey(size_t i) const { return entries[i].key; }
+		//items in sorted order once Sort has been called, submission order before
+		T& operator[](size_t i) { return items[entries[i].index]; }
+		const T& operator[](size_t i) const { return items[entries[i].index]; }
+	private:
+		std::vector<T> items;
+		std::vector<Entry> entries;
+		std::vector<Entry> scratch;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include<vector>
+#include<memory>
+
+#include"Texture.h"
+
+namespace sl
+{
+	class Shader;
+
+	//one step of a post processing chain, drawn as a single full screen triangle
+	struct PostProcessPass
+	{
+		Shader* shader = nullptr;//loaded with Graphics::LoadPostProcessShader
+		float scale = 1.0f;//output size relative to the canvas, 0.5 and 0.25 for half and quarter resolution, the last pass always fills the canvas
+		TextureFormat format = TextureFormat::RGBA8;//ignored for the last pass, which writes the canvas
+		TextureFilter filter = TextureFilter::Linear;//how this pass samples uSource and uScene
+	};
+
+	//transient color targets with their own framebuffer, released targets are handed out again for the same size and format
+	class RenderTargetPool
+	{
+	public:
+		struct Target
+		{
+			unsigned int texture = 0;
+			unsigned int framebuffer = 0;
+			int width = 0;
+			int height = 0;
+			TextureFormat format = TextureFormat::RGBA8;
+			size_t lastUsedFrame = 0;
+			bool inUse = false;
+		};
+	public:
+		RenderTargetPool() = default;
+		RenderTargetPool(const RenderTargetPool&) = delete;
+		RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+		~RenderTargetPool();
+
+		const Target* Acquire(int width, int height, TextureFormat format, size_t frame);
+		void Release(const Target* target);
+		//frees released targets not acquired for more than maxIdleFrames, such as ones sized for an old canvas
+		void Trim(size_t frame, size_t maxIdleFrames);
+		size_t GetTargetCount() const { return targets.size(); }
+	private:
+		static void Destroy(Target& target);
+	private:
+		std::vector<std::unique_ptr<Target>> targets;
+	};
+}
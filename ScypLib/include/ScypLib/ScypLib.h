@@ -5,4 +5,5 @@
 #include"Keyboard.h"
 #include"Logger.h"
 #include"Mouse.h"
-#include"Graphics.h"
\ No newline at end of file
+#include"Graphics.h"
+#include"SpatialHash.h"
\ No newline at end of file
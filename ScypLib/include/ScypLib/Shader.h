@@ -1,34 +1,111 @@
 #pragma once
 #include<string>
+#include<string_view>
+#include<vector>
 #include<unordered_map>
+#include<memory>
 
 #include<glm/glm.hpp>
 
+#include"ShaderCache.h"
+
 namespace sl
 {
+	//resolved once with Shader::GetUniform, setting through it needs no string hashing
+	struct UniformHandle
+	{
+		int location = -1;
+		unsigned int type = 0;//GL type of the uniform, checked by the setters in debug builds
+		int count = 0;//array length, 1 for plain uniforms
+		int buffer = -1;//index of the enabled uniform buffer holding it, -1 for plain uniforms
+		int offset = 0;//byte offset and array stride inside that buffer
+		int arrayStride = 0;
+		bool IsValid() const { return location != -1 || buffer != -1; }
+	};
+
 	class Shader
 	{
 	public:
-		Shader(const std::string& vertex, const std::string& fragment, bool isPath);
+		//#define flags for GetVariant, a source without matching #ifdef blocks gives the same program for every variant
+		static constexpr unsigned int NoDiscard = 1u << 0;//NO_DISCARD
+		static constexpr unsigned int Untinted = 1u << 1;//UNTINTED
+		static constexpr unsigned int SolidColor = 1u << 2;//SOLID_COLOR
+	public:
+		//with a cache the linked binary is reused when the sources and driver match, and saved after a compile otherwise
+		//the cache is only used during construction and is not kept
+		Shader(const std::string& vertex, const std::string& fragment, bool isPath, ShaderCache* cache = nullptr);
 		Shader() = default;
 		Shader& operator=(Shader&& other) noexcept;
 		~Shader();
-		void SetUniform1f(const std::string& name, float v);
-		void SetUniform1i(const std::string& name, int v);
-		void SetUniform1iv(const std::string& name, int count, int* data);
-		void SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3);
-		void SetUniform4i(const std::string& name, int v0, int v1, int v2, int v3);
-		void SetUniformMat4f(const std::string& name, const glm::mat4& matrix);
+		//all setters write straight into this program with glProgramUniform, whichever program is bound
+		void SetUniform1f(std::string_view name, float v);
+		void SetUniform1i(std::string_view name, int v);
+		void SetUniform1iv(std::string_view name, int count, int* data);
+		void SetUniform4f(std::string_view name, float v0, float v1, float v2, float v3);
+		void SetUniform4i(std::string_view name, int v0, int v1, int v2, int v3);
+		void SetUniformMat4f(std::string_view name, const glm::mat4& matrix);
+		bool HasUniform(std::string_view name) const;
+		//reflected at link time, array names have no [0] suffix, invalid when the uniform is not active
+		//members of a block only resolve once EnableUniformBuffer was called for it
+		UniformHandle GetUniform(std::string_view name) const;
+		void SetUniform(UniformHandle uniform, float v);
+		void SetUniform(UniformHandle uniform, const glm::vec2& v);
+		void SetUniform(UniformHandle uniform, const glm::vec3& v);
+		void SetUniform(UniformHandle uniform, const glm::vec4& v);
+		void SetUniform(UniformHandle uniform, int v);
+		void SetUniform(UniformHandle uniform, const glm::mat4& v);
+		void SetUniform(UniformHandle uniform, const float* values, int count);
+		void SetUniform(UniformHandle uniform, const int* values, int count);
+		//the shader owns a buffer for the named std140 block, setting its members only writes a cpu copy
+		//the copy is uploaded once when the shader is next used for drawing, then bound to the block's binding point
+		//binding 0 is the renderer's camera buffer, a block left on it is moved to the lowest binding no other block of the program uses
+		//binds through the generic GL_UNIFORM_BUFFER target as well, Graphics forgets its cached uniform buffer after calling it
+		bool EnableUniformBuffer(std::string_view blockName);
+		void UpdateUniformBuffers();
 		unsigned int GetHandle() const { return handle; };
+		//the shader compiled again with a #define line per set flag after #version, built on first use and kept
+		//uniforms are per program, a new variant does not inherit values set on this one
+		//cache is only consulted when the variant has to be built
+		Shader* GetVariant(unsigned int defines, ShaderCache* cache = nullptr);
+		bool HasVariant(unsigned int defines) const;
+		unsigned int GetDefines() const { return defines; }
+		bool IsVariantOf(const Shader* shader) const { return this == shader || base == shader; }
+	private:
+		struct Uniform
+		{
+			std::string name;
+			UniformHandle handle;
+			int block = -1;//active block index, -1 for plain uniforms
+		};
+		struct UniformBuffer
+		{
+			std::string name;
+			int block = -1;
+			int binding = 0;
+			unsigned int buffer = 0;
+			std::vector<unsigned char> data;
+			bool dirty = false;
+		};
 	private:
+		Shader(Shader* base, unsigned int defines, ShaderCache* cache);
+		static std::string AddDefines(const std::string& source, unsigned int defines);
 		std::string LoadShader(const std::string& filepath);
 		void ParseShader(const std::string& filepath, std::string& vertexShader, std::string& fragmentShader);
 		unsigned int CompileShader(unsigned int type, const std::string& source);
-		unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
-		int GetUniformLocation(const std::string& name) const;
+		unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader, ShaderCache* cache);
+		void Reflect();
+		const Uniform* FindUniform(std::string_view name) const;
+		void WriteUniformBuffer(const UniformHandle& uniform, const void* value, size_t size, int count = 1);
 	private:
-		unsigned int handle;
-		mutable std::unordered_map<std::string, int> uniformLocationCache;
+		unsigned int handle = 0;
+		std::vector<Uniform> uniforms;//sorted by name
+		std::vector<UniformBuffer> uniformBuffers;
+		//sources are kept on the base shader to build variants from
+		std::string vertexSource;
+		std::string fragmentSource;
+		Shader* base = nullptr;
+		unsigned int defines = 0;
+		std::unordered_map<unsigned int, std::unique_ptr<Shader>> variants;
 
 	};
 }
\ No newline at end of file
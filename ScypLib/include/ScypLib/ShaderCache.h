@@ -0,0 +1,36 @@
+#pragma once
+#include<string>
+
+namespace sl
+{
+	//on disk cache of linked program binaries, one file per program keyed by its sources and the driver that built it
+	//the entry stores the sources and driver strings as well and a load compares them, so a hash collision only misses
+	//needs a current gl context, a binary the driver refuses falls back to compiling the sources
+	class ShaderCache
+	{
+	public:
+		ShaderCache(const std::string& directory);
+
+		//linked program, or 0 when there is no usable binary
+		unsigned int Load(const std::string& vertexSource, const std::string& fragmentSource);
+		//program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		bool Save(unsigned int program, const std::string& vertexSource, const std::string& fragmentSource);
+
+		//false when the driver exposes no binary formats, loads then always miss
+		bool IsSupported() const { return supported; }
+		size_t GetHits() const { return hits; }
+		size_t GetMisses() const { return misses; }
+		//entries found on disk but stale, corrupt or refused by the driver, counted in the misses too
+		size_t GetRejected() const { return rejected; }
+	private:
+		unsigned long long GetKey(const std::string& vertexSource, const std::string& fragmentSource) const;
+		std::string GetEntryPath(unsigned long long key) const;
+	private:
+		std::string directory;
+		std::string driver;
+		bool supported = false;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t rejected = 0;
+	};
+}
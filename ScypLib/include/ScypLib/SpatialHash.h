@@ -0,0 +1,186 @@
+#pragma once
+#include<vector>
+#include<cmath>
+#include<cassert>
+#include<algorithm>
+#include<unordered_map>
+
+#include"Rect.h"
+
+namespace sl
+{
+	//uniform grid over RectF bounds, hashed by cell coordinate
+	//cellSize should be close to the typical object size, moves inside the same cells are O(1)
+	template<typename T>
+	class SpatialHash
+	{
+	public:
+		using Handle = unsigned int;
+	private:
+		struct CellRange
+		{
+			int left, right, top, bottom;
+			bool operator==(const CellRange& other) const
+			{
+				return left == other.left && right == other.right && top == other.top && bottom == other.bottom;
+			}
+		};
+		struct Item
+		{
+			RectF bounds;
+			T value;
+			CellRange cells;
+			unsigned int queryStamp;
+			bool alive;
+		};
+	public:
+		SpatialHash(float cellSize = 64.0f)
+			: cellSize(cellSize)
+		{
+			assert(cellSize > 0.0f);
+		}
+
+		Handle Insert(const RectF& bounds, const T& value)
+		{
+			Handle handle;
+			if (!freeHandles.empty())
+			{
+				handle = freeHandles.back();
+				freeHandles.pop_back();
+				items[handle] = Item{ bounds, value, GetCellRange(bounds), 0, true };
+			}
+			else
+			{
+				handle = Handle(items.size());
+				items.push_back(Item{ bounds, value, GetCellRange(bounds), 0, true });
+			}
+			AddToCells(handle, items[handle].cells);
+			size++;
+			return handle;
+		}
+		void Move(Handle handle, const RectF& bounds)
+		{
+			assert(handle < items.size() && items[handle].alive);
+			Item& item = items[handle];
+			item.bounds = bounds;
+			CellRange cells = GetCellRange(bounds);
+			if (cells == item.cells) return;
+			RemoveFromCells(handle, item.cells);
+			item.cells = cells;
+			AddToCells(handle, cells);
+		}
+		void Remove(Handle handle)
+		{
+			assert(handle < items.size() && items[handle].alive);
+			RemoveFromCells(handle, items[handle].cells);
+			items[handle].alive = false;
+			freeHandles.push_back(handle);
+			size--;
+		}
+		void Clear()
+		{
+			items.clear();
+			freeHandles.clear();
+			cells.clear();
+			size = 0;
+		}
+
+		//calls func(handle, value) once for every item overlapping area
+		template<typename Func>
+		void ForEachInRect(const RectF& area, Func func)
+		{
+			unsigned int stamp = NextStamp();
+			CellRange range = GetCellRange(area);
+			for (int y = range.top; y <= range.bottom; y++)
+			{
+				for (int x = range.left; x <= range.right; x++)
+				{
+					auto it = cells.find(Vec2i(x, y));
+					if (it == cells.end()) continue;
+					for (Handle handle : it->second)
+					{
+						Item& item = items[handle];
+						if (item.queryStamp == stamp) continue;
+						item.queryStamp = stamp;
+						if (item.bounds.IsOverlappingWith(area)) func(handle, item.value);
+					}
+				}
+			}
+		}
+		//calls func(handle, value) for every item containing point
+		template<typename Func>
+		void ForEachAtPoint(const Vec2f& point, Func func)
+		{
+			auto it = cells.find(Vec2i(CellCoord(point.x), CellCoord(point.y)));
+			if (it == cells.end()) return;
+			for (Handle handle : it->second)
+			{
+				Item& item = items[handle];
+				if (item.bounds.Contains(point)) func(handle, item.value);
+			}
+		}
+		void QueryRect(const RectF& area, std::vector<T>& out)
+		{
+			ForEachInRect(area, [&out](Handle, const T& value) { out.push_back(value); });
+		}
+		void QueryPoint(const Vec2f& point, std::vector<T>& out)
+		{
+			ForEachAtPoint(point, [&out](Handle, const T& value) { out.push_back(value); });
+		}
+
+		const RectF& GetBounds(Handle handle) const { return items[handle].bounds; }
+		const T& GetValue(Handle handle) const { return items[handle].value; }
+		size_t GetSize() const { return size; }
+		float GetCellSize() const { return cellSize; }
+	private:
+		int CellCoord(float v) const
+		{
+			return int(std::floor(v / cellSize));
+		}
+		CellRange GetCellRange(const RectF& bounds) const
+		{
+			return { CellCoord(bounds.left), CellCoord(bounds.right), CellCoord(bounds.top), CellCoord(bounds.bottom) };
+		}
+		void AddToCells(Handle handle, const CellRange& range)
+		{
+			for (int y = range.top; y <= range.bottom; y++)
+			{
+				for (int x = range.left; x <= range.right; x++)
+				{
+					cells[Vec2i(x, y)].push_back(handle);
+				}
+			}
+		}
+		void RemoveFromCells(Handle handle, const CellRange& range)
+		{
+			for (int y = range.top; y <= range.bottom; y++)
+			{
+				for (int x = range.left; x <= range.right; x++)
+				{
+					//cells are kept once created so objects moving back and forth do not reallocate them
+					std::vector<Handle>& cell = cells[Vec2i(x, y)];
+					auto it = std::find(cell.begin(), cell.end(), handle);
+					assert(it != cell.end());
+					*it = cell.back();
+					cell.pop_back();
+				}
+			}
+		}
+		unsigned int NextStamp()
+		{
+			if (++queryStamp == 0)
+			{
+				for (Item& item : items) item.queryStamp = 0;
+				queryStamp = 1;
+			}
+			return queryStamp;
+		}
+	private:
+		float cellSize;
+		size_t size = 0;
+		unsigned int queryStamp = 0;
+		std::vector<Item> items;
+		std::vector<Handle> freeHandles;
+		std::unordered_map<Vec2i, std::vector<Handle>> cells;
+	};
+}
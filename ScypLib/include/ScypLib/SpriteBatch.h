@@ -0,0 +1,93 @@
+#pragma once
+#include<vector>
+
+#include"Rect.h"
+#include"Color.h"
+#include"Sprite.h"
+#include"Texture.h"
+
+namespace sl
+{
+	//retained sprites kept in SoA arrays, the instance buffer stays on the gpu and only changed sprites are re-uploaded
+	//drawn with Graphics::DrawSpriteBatch as a single renderable at the current draw layer
+	class SpriteBatch
+	{
+		friend class Graphics;
+	public:
+		//stale handles (removed sprites) are rejected through the generation
+		struct Handle
+		{
+			unsigned int index = ~0u;
+			unsigned int generation = 0;
+		};
+	private:
+		struct Slot
+		{
+			unsigned int dense = ~0u;
+			unsigned int generation = 0;
+		};
+	public:
+		SpriteBatch(size_t capacity = 1024);
+		SpriteBatch(const SpriteBatch&) = delete;
+		SpriteBatch& operator=(const SpriteBatch&) = delete;
+		~SpriteBatch();
+
+		//the sprite's shader is ignored, the whole batch uses the one passed to DrawSpriteBatch
+		Handle Add(const Sprite& sprite);
+		void Update(Handle handle, const Sprite& sprite);
+		void Remove(Handle handle);
+		void Clear();
+
+		void SetPos(Handle handle, Vec2f pos);
+		void SetRotation(Handle handle, float angle);
+		void SetColorTint(Handle handle, const Color& tint);
+		void SetNDCUV(Handle handle, const RectF& uv);
+
+		bool IsValid(Handle handle) const;
+		Vec2f GetPos(Handle handle) const;
+		size_t GetSize() const { return positions.size(); }
+		bool IsEmpty() const { return positions.empty(); }
+		bool IsOpaque() const { return translucentCount == 0; }
+		//grown as sprites are added or moved outward, rebuilt only after a sprite on the edge moved inward or was removed
+		RectF GetBounds();
+	private:
+		unsigned int GetDense(Handle handle) const;
+		unsigned short AcquireTexture(const Texture* texture);
+		void ReleaseTexture(unsigned short index);
+		void Write(unsigned int dense, const Sprite& sprite);
+		RectF GetSpriteBounds(unsigned int dense) const;
+		void GrowBounds(const RectF& box);
+		void MoveBounds(const RectF& previous, unsigned int dense);
+		void MarkDirty(unsigned int dense);
+		void MarkTextureDirty(unsigned short textureIndex);
+		void MarkAllDirty();
+		bool IsTranslucent(unsigned int dense) const;
+		void Reserve(size_t instanceSize, size_t capacity);
+	private:
+		//dense sprite state, index i belongs to handles[i]
+		std::vector<Vec2f> positions;
+		std::vector<Vec2f> sizes;
+		std::vector<Vec2f> origins;
+		std::vector<float> angles;//radians
+		std::vector<RectF> uvs;
+		std::vector<Color> colors;
+		std::vector<unsigned short> textureIndices;
+		std::vector<unsigned int> handles;
+		//sparse handle table
+		std::vector<Slot> slots;
+		std::vector<unsigned int> freeSlots;
+		//distinct textures referenced by the sprites, slots are baked into the uploaded instances
+		std::vector<const Texture*> textures;
+		std::vector<unsigned int> textureRefs;
+		std::vector<int> textureSlots;
+		size_t translucentCount = 0;
+		//gpu side
+		unsigned int buffer = 0;
+		size_t gpuCapacity = 0;
+		float layer = 0.0f;
+		std::vector<unsigned int> dirtyIndices;
+		std::vector<bool> dirtyFlags;
+		bool boundsDirty = true;
+		RectF bounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+	};
+}
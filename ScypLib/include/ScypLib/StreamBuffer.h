@@ -0,0 +1,37 @@
+#pragma once
+#include<vector>
+
+#include<GL/glew.h>
+
+namespace sl
+{
+	//persistently mapped buffer split into regionCount regions, each guarded by a fence
+	//so the cpu can fill one region while the gpu still reads the previous ones
+	class StreamBuffer
+	{
+	public:
+		StreamBuffer(size_t regionSize, int regionCount = 3);
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+		~StreamBuffer();
+
+		void* Reserve(size_t size, size_t alignment, size_t& offset);
+		void EndFrame();
+
+		unsigned int GetHandle() const { return handle; }
+		size_t GetRegionSize() const { return regionSize; }
+		size_t GetStalls() const { return stalls; }
+		static bool IsSupported();
+	private:
+		void NextRegion();
+	private:
+		unsigned int handle = 0;
+		unsigned char* mapped = nullptr;
+		size_t regionSize = 0;
+		int regionCount = 0;
+		int region = 0;
+		size_t cursor = 0;
+		size_t stalls = 0;
+		std::vector<GLsync> fences;
+	};
+}
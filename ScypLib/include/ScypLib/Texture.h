@@ -1,8 +1,11 @@
 #pragma once
 #include<string>
+#include<vector>
 
 #include<GL/glew.h>
 
+#include"Rect.h"
+
 namespace sl
 {
 	enum class TextureFilter
@@ -24,25 +27,86 @@ namespace sl
 		MirrorClampToEdge = GL_MIRROR_CLAMP_TO_EDGE
 	};
 
+	//storage formats for render targets, RGB10A2 and RGBA16F keep more precision through post processing
+	enum class TextureFormat
+	{
+		RGBA8 = GL_RGBA8,
+		RGB10A2 = GL_RGB10_A2,
+		RGBA16F = GL_RGBA16F
+	};
+
+	class TextureArray;
+	class TextureAtlas;
+
 	class Texture
 	{
+		friend class TextureAtlas;
+		friend class Graphics;
 	public:
 		Texture(int width, int height, int BPP, unsigned char* buffer, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
 		Texture(const std::string& path, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+		Texture(TextureArray* array, int layer, int BPP, const unsigned char* buffer);
+		//already decoded rgba8 levels, each half the size of the previous one, with the alpha classification precomputed
+		Texture(int width, int height, const std::vector<const unsigned char*>& levels, bool binaryAlpha, bool opaque, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter);
+		//reports the final size but holds a 1x1 placeholder until an async load stores the pixels
+		Texture(int width, int height, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter);
+		//immutable render target storage, nothing is uploaded and the contents are undefined until drawn to
+		Texture(int width, int height, TextureFormat format);
+		//sub-rectangle of an atlas page, buffer is the sub-image and only scanned for alpha
+		Texture(TextureAtlas* atlas, const Texture* page, const RectF& region, int width, int height, int BPP, const unsigned char* buffer);
 		~Texture();
 
+		//writes a sub-rectangle of level 0, buffer rows are width pixels wide
+		void Update(int x, int y, int width, int height, int BPP, const unsigned char* buffer);
+
 		inline int GetWidth() const { return width; }
 		inline int GetHeight() const { return height; }
 		unsigned int GetHandle() const { return handle; }
 		int GetChannels() const { return BPP; }
 		bool IsBinaryAlpha() const { return binaryAlpha; }
+		//every texel has full alpha, opaque draws of it need no alpha test, false when it was never scanned
+		bool IsOpaque() const { return opaque; }
+		//false while an async load is still decoding or waiting for upload
+		bool IsReady() const { return ready; }
+		//set when the image lives in a layer of a texture array page, handle is then the page's handle
+		TextureArray* GetArray() const { return array; }
+		int GetArrayLayer() const { return arrayLayer; }
+		//set when the image was packed into an atlas page, handle is then the page's handle and uvs are remapped into region
+		TextureAtlas* GetAtlas() const { return atlas; }
+		const Texture* GetAtlasPage() const { return atlasPage; }
+		const RectF& GetAtlasRegion() const { return atlasRegion; }
+		RectF MapUV(const RectF& uv) const
+		{
+			if (!atlasPage) return uv;
+			float regionWidth = atlasRegion.right - atlasRegion.left;
+			float regionHeight = atlasRegion.bottom - atlasRegion.top;
+			return RectF(atlasRegion.left + uv.left * regionWidth, atlasRegion.left + uv.right * regionWidth,
+				atlasRegion.top + uv.top * regionHeight, atlasRegion.top + uv.bottom * regionHeight);
+		}
 	private:
 		void Init(const unsigned char* buffer, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter);
+		//creates handle with immutable rgba8 storage through dsa, no texture unit binding is touched
+		void Allocate(int width, int height, int levelCount, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter);
+		//replaces handle with new storage of another size, keeping the sampling parameters
+		void Reallocate(int width, int height, int levelCount);
+		void ScanAlpha(const unsigned char* buffer, size_t pixelCount);
+		//replaces the image and the handle, pixels may be an offset into the bound GL_PIXEL_UNPACK_BUFFER so the alpha classification comes precomputed
+		void Store(int width, int height, int BPP, const void* pixels, bool binaryAlpha, bool opaque);
+		//rgba8 mip chain, level i is max(1, size >> i), only level 0 is used when the filter has no mipmaps
+		void Store(int width, int height, const std::vector<const unsigned char*>& levels, bool binaryAlpha, bool opaque);
 	private:
 		unsigned int handle = 0;
 		int width = 0;
 		int height = 0;
 		int BPP = 0;//bits per pixel
 		bool binaryAlpha = true;
+		bool opaque = true;
+		bool mipmapped = false;
+		bool ready = true;
+		TextureArray* array = nullptr;
+		int arrayLayer = -1;
+		TextureAtlas* atlas = nullptr;
+		const Texture* atlasPage = nullptr;
+		RectF atlasRegion = { 0.0f, 1.0f, 0.0f, 1.0f };
 	};
 }
\ No newline at end of file
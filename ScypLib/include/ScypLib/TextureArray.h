@@ -0,0 +1,42 @@
+#pragma once
+#include<vector>
+
+#include"Texture.h"
+
+namespace sl
+{
+	//GL_TEXTURE_2D_ARRAY page holding same sized rgba8 images, one per layer
+	class TextureArray
+	{
+	public:
+		TextureArray(int width, int height, int layers, TextureWrap wrap = TextureWrap::ClampToEdge, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+		TextureArray(const TextureArray&) = delete;
+		TextureArray& operator=(const TextureArray&) = delete;
+		~TextureArray();
+
+		int AllocateLayer();
+		void FreeLayer(int layer);
+		//BPP of 1, 3 or 4, mipmaps are only marked stale here
+		void Upload(int layer, int BPP, const unsigned char* buffer);
+		//rebuilds the mip chain of every layer once after any number of uploads, called by Graphics before drawing
+		void UpdateMipmaps();
+
+		unsigned int GetHandle() const { return handle; }
+		int GetWidth() const { return width; }
+		int GetHeight() const { return height; }
+		int GetLayerCount() const { return layers; }
+		bool IsFull() const { return freeLayers.empty(); }
+		bool IsCompatible(int width, int height, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter) const;
+	private:
+		unsigned int handle = 0;
+		int width = 0;
+		int height = 0;
+		int layers = 0;
+		TextureWrap wrap;
+		TextureFilter minFilter;
+		TextureFilter magFilter;
+		bool mipmapped = false;
+		bool mipmapsDirty = false;
+		std::vector<int> freeLayers;
+	};
+}
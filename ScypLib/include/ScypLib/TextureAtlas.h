@@ -0,0 +1,78 @@
+#pragma once
+#include<string>
+#include<vector>
+#include<memory>
+#include<unordered_map>
+
+#include"Texture.h"
+
+namespace sl
+{
+	//packs small images into shared pages with a skyline packer, each image is handed out as a sub-texture
+	//sub-textures draw like any other texture, their uvs are remapped into the page when the instance is built
+	class TextureAtlas
+	{
+		friend class Graphics;
+	private:
+		struct SkylineNode
+		{
+			int x;
+			int y;
+			int width;
+		};
+		struct Page
+		{
+			std::unique_ptr<Texture> texture;
+			std::vector<SkylineNode> skyline;
+			bool mipmapsDirty = false;
+		};
+		struct Entry
+		{
+			std::unique_ptr<Texture> texture;
+			std::string name;
+			int page = -1;
+			int x = 0;//top left of the image, the extruded border sits around it
+			int y = 0;
+		};
+	public:
+		//padding is extruded from the image's edge pixels so filtering never reaches a neighbour
+		TextureAtlas(int pageSize = 2048, int padding = 2, TextureFilter minFilter = TextureFilter::Nearest, TextureFilter magFilter = TextureFilter::Nearest);
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		//returns the existing sub-texture when name was added before, nullptr when the image is larger than a page
+		Texture* Add(const std::string& name, int width, int height, int BPP, const unsigned char* buffer);
+		void Remove(Texture* texture);
+		Texture* Find(const std::string& name) const;
+
+		size_t GetPageCount() const { return pages.size(); }
+		const Texture* GetPage(size_t index) const { return pages[index].texture.get(); }
+		size_t GetTextureCount() const { return entries.size(); }
+		//share of the packed area lost to removed images, repacking reclaims it
+		float GetFragmentation() const;
+		//rebuilds the mip chain of pages changed since the last call, called by Graphics before drawing
+		void UpdateMipmaps();
+	private:
+		//packs every live image into fresh pages, sub-texture pointers stay valid, the replaced pages are returned
+		std::vector<std::unique_ptr<Texture>> Repack();
+		bool Place(int width, int height, int& page, int& x, int& y);
+		bool FindPosition(const Page& page, int width, int height, int& x, int& y, size_t& node) const;
+		int Fit(const Page& page, size_t node, int width, int height) const;
+		void Insert(Page& page, size_t node, int x, int y, int width, int height);
+		int AddPage();
+		void Upload(const Entry& entry, int width, int height, int BPP, const unsigned char* buffer);
+		RectF GetRegion(int x, int y, int width, int height) const;
+	private:
+		int pageSize = 2048;
+		int padding = 2;
+		TextureFilter minFilter;
+		TextureFilter magFilter;
+		bool mipmapped = false;
+		std::vector<Page> pages;
+		std::unordered_map<const Texture*, Entry> entries;
+		std::unordered_map<std::string, Texture*> names;
+		size_t usedArea = 0;
+		size_t packedArea = 0;
+		std::vector<unsigned char> uploadBuffer;
+	};
+}
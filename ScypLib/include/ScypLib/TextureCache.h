@@ -0,0 +1,44 @@
+#pragma once
+#include<string>
+#include<vector>
+#include<atomic>
+
+#include"MappedFile.h"
+
+namespace sl
+{
+	//on disk cache of decoded images, one file per source keyed by path, size and modification time
+	//entries hold rgba8 levels ready for upload plus the alpha classification, and are read through a memory mapping
+	class TextureCache
+	{
+	public:
+		struct Image
+		{
+			int width = 0;
+			int height = 0;
+			bool binaryAlpha = true;
+			bool opaque = false;//every texel has full alpha
+			std::vector<const unsigned char*> levels;//point into file, level i is max(1, size >> i)
+			MappedFile file;
+		};
+	public:
+		TextureCache(const std::string& directory);
+
+		//thread safe, a hit without mips does not count when withMips is set
+		bool Load(const std::string& sourcePath, bool withMips, Image& image);
+		//pixels are the decoded source, converted to rgba8 and box filtered down to 1x1 when withMips is set
+		//image receives the written entry mapped like a Load would, without counting as a hit
+		bool Save(const std::string& sourcePath, int width, int height, int BPP, const unsigned char* pixels, bool withMips, Image* image = nullptr);
+
+		size_t GetHits() const { return hits; }
+		size_t GetMisses() const { return misses; }
+	private:
+		bool Read(const std::string& sourcePath, bool withMips, Image& image);
+		std::string GetEntryPath(const std::string& sourcePath) const;
+		static bool GetSourceStamp(const std::string& sourcePath, unsigned long long& size, long long& time);
+	private:
+		std::string directory;
+		std::atomic<size_t> hits = 0;
+		std::atomic<size_t> misses = 0;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include<string>
+#include<algorithm>
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+
+#include"TextureCache.h"
+#include"AssetPack.h"
+
+namespace sl
+{
+	//decodes image files on worker threads, results are collected on the render thread and uploaded there
+	class TextureLoader
+	{
+	public:
+		struct Result
+		{
+			unsigned long long id = 0;
+			std::string path;
+			int width = 0;
+			int height = 0;
+			int BPP = 0;
+			std::vector<unsigned char> pixels;//empty when decoding failed or the image came from the cache
+			TextureCache::Image cached;//rgba8, level 0 is uploaded
+			bool binaryAlpha = true;
+			bool opaque = false;
+
+			bool IsValid() const { return !pixels.empty() || cached.file.IsOpen(); }
+			const unsigned char* GetPixels() const { return cached.file.IsOpen() ? cached.levels[0] : pixels.data(); }
+			//bytes of every level to upload, cached levels are contiguous in the mapping
+			size_t GetSize() const
+			{
+				if (!IsValid()) return 0;
+				if (!cached.file.IsOpen()) return size_t(width) * height * BPP;
+				size_t size = 0;
+				for (size_t level = 0; level < cached.levels.size(); level++) size += size_t(std::max(1, width >> level)) * std::max(1, height >> level) * 4;
+				return size;
+			}
+		};
+	private:
+		struct Job
+		{
+			unsigned long long id;
+			std::string path;
+			bool flip;
+			TextureCache* cache;
+			bool withMips;
+			const AssetPack* pack;
+		};
+	public:
+		TextureLoader(int threadCount);
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+		~TextureLoader();
+
+		//with a cache the decode is skipped on a hit, and a miss writes the decoded image back
+		//with a pack the image is decoded from its mapping when the pack holds path
+		void Enqueue(unsigned long long id, const std::string& path, bool flipVertically, TextureCache* cache = nullptr, bool withMips = false, const AssetPack* pack = nullptr);
+		//non blocking, false when no decoded image is waiting
+		bool PopResult(Result& result);
+		//bytes of decoded pixels waiting for upload at the front of the queue, 0 when empty
+		size_t PeekResultSize();
+	private:
+		void WorkerLoop();
+		//alpha is the last byte of 2 and 4 channel pixels, 1 and 3 channel images are opaque
+		static void ScanAlpha(const std::vector<unsigned char>& pixels, int BPP, bool& binaryAlpha, bool& opaque);
+	private:
+		std::vector<std::thread> workers;
+		std::mutex jobMutex;
+		std::condition_variable jobCondition;
+		std::deque<Job> jobs;
+		bool stopping = false;
+		std::mutex resultMutex;
+		std::deque<Result> results;
+	};
+}
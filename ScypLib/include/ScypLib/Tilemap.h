@@ -0,0 +1,66 @@
+#pragma once
+#include<vector>
+
+#include"Rect.h"
+#include"Texture.h"
+
+namespace sl
+{
+	//grid of atlas tile indices split into fixed size chunks, each chunk keeps its instances in an immutable gpu buffer
+	//chunks are rebuilt by Graphics::DrawTilemap only after one of their tiles changed
+	class Tilemap
+	{
+		friend class Graphics;
+	private:
+		struct Chunk
+		{
+			unsigned int buffer = 0;
+			unsigned int instanceCount = 0;
+			int tileCount = 0;//non empty tiles, chunks without any are never drawn
+			bool dirty = true;
+			//state baked into the instances, a mismatch at draw time triggers a rebuild
+			int textureSlot = -1;
+			float layer = 0.0f;
+		};
+	public:
+		//tileWidth and tileHeight are in atlas pixels, tiles are drawn at the same size unless SetTileSize is called
+		Tilemap(const Texture* atlas, int tileWidth, int tileHeight, int width, int height, int chunkSize = 32);
+		Tilemap(const Tilemap&) = delete;
+		Tilemap& operator=(const Tilemap&) = delete;
+		~Tilemap();
+
+		//tile is an index into the atlas read row by row, -1 leaves the cell empty
+		void SetTile(int x, int y, int tile);
+		void Fill(int tile);
+		void SetPosition(Vec2f position);
+		void SetTileSize(Vec2f size);
+
+		int GetTile(int x, int y) const;
+		const Texture* GetAtlas() const { return atlas; }
+		int GetWidth() const { return width; }
+		int GetHeight() const { return height; }
+		int GetChunkSize() const { return chunkSize; }
+		Vec2f GetPosition() const { return position; }
+		Vec2f GetTileSize() const { return tileSize; }
+		RectF GetRect() const { return RectF(position, tileSize.x * width, tileSize.y * height); }
+		RectF GetTileUV(int tile) const;
+	private:
+		RectF GetChunkRect(int chunkX, int chunkY) const;
+		void MarkAllDirty();
+		void UploadChunk(Chunk& chunk, const void* instances, size_t instanceSize, unsigned int instanceCount);
+	private:
+		const Texture* atlas = nullptr;
+		int tileWidth = 0;
+		int tileHeight = 0;
+		int atlasColumns = 1;
+		int width = 0;
+		int height = 0;
+		int chunkSize = 32;
+		int chunksX = 0;
+		int chunksY = 0;
+		Vec2f position = { 0.0f, 0.0f };
+		Vec2f tileSize = { 0.0f, 0.0f };
+		std::vector<int> tiles;
+		std::vector<Chunk> chunks;
+	};
+}
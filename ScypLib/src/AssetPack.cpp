@@ -0,0 +1,395 @@
+#include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<climits>
+#include<algorithm>
+#include<filesystem>
+
+#include"stb/stb_image.h"
+
+#include"ScypLib/AssetPack.h"
+
+namespace sl
+{
+	namespace
+	{
+		constexpr uint32_t packMagic = 0x4B504C53;//"SLPK"
+		constexpr uint32_t packVersion = 1;
+		constexpr uint16_t entryCompressed = 1;
+
+		struct PackHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;//entries follow the header, then the names
+			uint32_t namesSize;
+		};
+
+		//lsb first bit stream, huffman codes are reversed before they go in
+		class BitWriter
+		{
+		public:
+			BitWriter(std::vector<unsigned char>& out) : out(out) {}
+			void Write(uint32_t bits, int count)
+			{
+				buffer |= bits << used;
+				used += count;
+				while (used >= 8)
+				{
+					out.push_back((unsigned char)(buffer & 0xFF));
+					buffer >>= 8;
+					used -= 8;
+				}
+			}
+			void WriteCode(uint32_t code, int length)
+			{
+				uint32_t reversed = 0;
+				for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+				Write(reversed, length);
+			}
+			void Flush()
+			{
+				if (used > 0) Write(0, 8 - used);
+			}
+		private:
+			std::vector<unsigned char>& out;
+			uint32_t buffer = 0;
+			int used = 0;
+		};
+
+		//fixed huffman literal/length alphabet from rfc 1951
+		void WriteLiteral(BitWriter& bits, int symbol)
+		{
+			if (symbol < 144) bits.WriteCode(0x30 + symbol, 8);
+			else if (symbol < 256) bits.WriteCode(0x190 + symbol - 144, 9);
+			else if (symbol < 280) bits.WriteCode(symbol - 256, 7);
+			else bits.WriteCode(0xC0 + symbol - 280, 8);
+		}
+
+		void WriteMatch(BitWriter& bits, int length, int distance)
+		{
+			static const int lengthBase[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+			static const int lengthExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+			static const int distanceBase[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+			static const int distanceExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+			int lengthCode = 28;
+			while (lengthBase[lengthCode] > length) lengthCode--;
+			WriteLiteral(bits, 257 + lengthCode);
+			bits.Write(uint32_t(length - lengthBase[lengthCode]), lengthExtra[lengthCode]);
+
+			int distanceCode = 29;
+			while (distanceBase[distanceCode] > distance) distanceCode--;
+			bits.WriteCode(uint32_t(distanceCode), 5);
+			bits.Write(uint32_t(distance - distanceBase[distanceCode]), distanceExtra[distanceCode]);
+		}
+
+		bool WritePadding(FILE* file, size_t count)
+		{
+			const unsigned char zeros[64] = {};
+			while (count > 0)
+			{
+				size_t chunk = std::min(count, sizeof(zeros));
+				if (fwrite(zeros, 1, chunk, file) != chunk) return false;
+				count -= chunk;
+			}
+			return true;
+		}
+	}
+
+	struct AssetPack::Entry
+	{
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t nameOffset;
+		uint16_t nameLength;
+		uint16_t flags;
+	};
+
+	AssetPack::AssetPack(const std::string& path)
+	{
+		Open(path);
+	}
+
+	bool AssetPack::Open(const std::string& path)
+	{
+		Close();
+		if (!file.Open(path)) return false;
+
+		const unsigned char* data = file.GetData();
+		size_t fileSize = file.GetSize();
+		PackHeader header;
+		bool valid = fileSize >= sizeof(header);
+		if (valid)
+		{
+			memcpy(&header, data, sizeof(header));
+			valid = header.magic == packMagic && header.version == packVersion &&
+				fileSize >= sizeof(header) + size_t(header.entryCount) * sizeof(Entry) + header.namesSize;
+		}
+		//the mapping is page aligned and entries follow a 16 byte header, so they are read in place
+		const Entry* index = valid ? reinterpret_cast<const Entry*>(data + sizeof(header)) : nullptr;
+		for (uint32_t i = 0; valid && i < header.entryCount; i++)
+		{
+			const Entry& entry = index[i];
+			valid = entry.offset <= fileSize && entry.storedSize <= fileSize - entry.offset &&
+				size_t(entry.nameOffset) + entry.nameLength <= header.namesSize &&
+				((entry.flags & entryCompressed) || entry.storedSize == entry.size);
+		}
+		if (!valid)
+		{
+			file.Close();
+			return false;
+		}
+		entries = index;
+		entryCount = header.entryCount;
+		names = reinterpret_cast<const char*>(data + sizeof(header) + size_t(header.entryCount) * sizeof(Entry));
+		return true;
+	}
+
+	void AssetPack::Close()
+	{
+		file.Close();
+		entries = nullptr;
+		entryCount = 0;
+		names = nullptr;
+	}
+
+	bool AssetPack::Contains(std::string_view path) const
+	{
+		return Find(path) != nullptr;
+	}
+
+	bool AssetPack::Read(std::string_view path, Asset& asset) const
+	{
+		asset = Asset();
+		const Entry* entry = Find(path);
+		if (!entry) return false;
+
+		const unsigned char* stored = file.GetData() + entry->offset;
+		if (!(entry->flags & entryCompressed))
+		{
+			asset.data = stored;
+			asset.size = size_t(entry->size);
+			return true;
+		}
+		if (entry->size == 0 || entry->size > INT_MAX || entry->storedSize > INT_MAX) return false;
+		asset.owned.resize(size_t(entry->size));
+		int inflated = stbi_zlib_decode_buffer(reinterpret_cast<char*>(asset.owned.data()), int(entry->size),
+			reinterpret_cast<const char*>(stored), int(entry->storedSize));
+		if (inflated != int(entry->size))
+		{
+			asset = Asset();
+			return false;
+		}
+		asset.data = asset.owned.data();
+		asset.size = asset.owned.size();
+		return true;
+	}
+
+	bool AssetPack::Load(const AssetPack* pack, const std::string& path, Asset& asset)
+	{
+		if (pack && pack->Read(path, asset)) return true;
+
+		asset = Asset();
+		FILE* file = nullptr;
+		errno_t err = fopen_s(&file, path.c_str(), "rb");
+		if (err != 0 || !file) return false;
+		fseek(file, 0, SEEK_END);
+		size_t size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		asset.owned.resize(size);
+		bool read = size == 0 || fread(asset.owned.data(), size, 1, file) == 1;
+		fclose(file);
+		if (!read || size == 0)
+		{
+			asset = Asset();
+			return false;
+		}
+		asset.data = asset.owned.data();
+		asset.size = size;
+		return true;
+	}
+
+	bool AssetPack::Build(const std::string& packPath, const std::vector<Source>& sources)
+	{
+		std::vector<std::pair<std::string, const Source*>> sorted;
+		sorted.reserve(sources.size());
+		for (const Source& source : sources)
+		{
+			if (source.alignment == 0 || (source.alignment & (source.alignment - 1)) != 0) return false;
+			sorted.emplace_back(Normalize(source.name), &source);
+			if (sorted.back().first.size() > UINT16_MAX) return false;
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return std::string_view(a.first) < std::string_view(b.first); });
+
+		std::string nameBlob;
+		std::vector<Entry> index(sorted.size());
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			if (i > 0 && sorted[i].first == sorted[i - 1].first) return false;
+			index[i].nameOffset = uint32_t(nameBlob.size());
+			index[i].nameLength = uint16_t(sorted[i].first.size());
+			nameBlob += sorted[i].first;
+		}
+
+		PackHeader header{};
+		header.magic = packMagic;
+		header.version = packVersion;
+		header.entryCount = uint32_t(index.size());
+		header.namesSize = uint32_t(nameBlob.size());
+
+		//written next to the pack and renamed so a running game never maps a half written file
+		std::string tempPath = packPath + ".tmp";
+		FILE* file = nullptr;
+		errno_t err = fopen_s(&file, tempPath.c_str(), "wb");
+		if (err != 0 || !file) return false;
+
+		//the index size is known up front, data is streamed after it and the index filled in last
+		uint64_t offset = sizeof(header) + index.size() * sizeof(Entry) + nameBlob.size();
+		bool written = WritePadding(file, size_t(offset));
+		for (size_t i = 0; written && i < sorted.size(); i++)
+		{
+			const Source& source = *sorted[i].second;
+			Entry& entry = index[i];
+			MappedFile input;
+			std::error_code error;
+			if (!input.Open(source.path) && (std::filesystem::file_size(source.path, error) != 0 || error))
+			{
+				written = false;
+				break;
+			}
+
+			const unsigned char* data = input.GetData();
+			entry.size = input.GetSize();
+			entry.storedSize = entry.size;
+			entry.flags = 0;
+			std::vector<unsigned char> compressed;
+			if (source.compress && entry.size > 0 && entry.size < INT_MAX)
+			{
+				compressed = Deflate(data, size_t(entry.size));
+				if (compressed.size() < entry.size - entry.size / 8)
+				{
+					data = compressed.data();
+					entry.storedSize = compressed.size();
+					entry.flags |= entryCompressed;
+				}
+			}
+
+			uint64_t aligned = (offset + source.alignment - 1) & ~uint64_t(source.alignment - 1);
+			written = WritePadding(file, size_t(aligned - offset)) && (entry.storedSize == 0 || fwrite(data, 1, size_t(entry.storedSize), file) == entry.storedSize);
+			entry.offset = aligned;
+			offset = aligned + entry.storedSize;
+		}
+		written = written && fseek(file, 0, SEEK_SET) == 0 &&
+			fwrite(&header, sizeof(header), 1, file) == 1 &&
+			(index.empty() || fwrite(index.data(), sizeof(Entry), index.size(), file) == index.size()) &&
+			fwrite(nameBlob.data(), 1, nameBlob.size(), file) == nameBlob.size();
+		fclose(file);
+
+		std::error_code error;
+		if (written) std::filesystem::rename(tempPath, packPath, error);
+		if (!written || error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	const AssetPack::Entry* AssetPack::Find(std::string_view path) const
+	{
+		if (!entries) return nullptr;
+		std::string name = Normalize(path);
+		const Entry* end = entries + entryCount;
+		const Entry* it = std::lower_bound(entries, end, std::string_view(name), [this](const Entry& entry, std::string_view key) { return GetName(entry) < key; });
+		return it != end && GetName(*it) == name ? it : nullptr;
+	}
+
+	std::string_view AssetPack::GetName(const Entry& entry) const
+	{
+		return std::string_view(names + entry.nameOffset, entry.nameLength);
+	}
+
+	std::string AssetPack::Normalize(std::string_view path)
+	{
+		std::string name(path);
+		std::replace(name.begin(), name.end(), '\\', '/');
+		while (name.starts_with("./")) name.erase(0, 2);
+		return name;
+	}
+
+	std::vector<unsigned char> AssetPack::Deflate(const unsigned char* data, size_t size)
+	{
+		constexpr size_t windowSize = 32768;
+		constexpr size_t hashSize = 1 << 15;
+		constexpr size_t none = SIZE_MAX;
+		constexpr int maxChain = 64;
+		constexpr size_t maxMatch = 258;
+
+		//zlib header for deflate with a 32k window, then one final block with the fixed codes
+		std::vector<unsigned char> out = { 0x78, 0x5E };
+		out.reserve(size / 2 + 64);
+		BitWriter bits(out);
+		bits.Write(1, 1);
+		bits.Write(1, 2);
+
+		std::vector<size_t> head(hashSize, none);
+		std::vector<size_t> previous(windowSize, none);
+		auto hash = [data](size_t i) { return ((uint32_t(data[i]) << 10) ^ (uint32_t(data[i + 1]) << 5) ^ data[i + 2]) & (hashSize - 1); };
+		auto insert = [&](size_t i)
+		{
+			uint32_t h = hash(i);
+			previous[i % windowSize] = head[h];
+			head[h] = i;
+		};
+
+		size_t i = 0;
+		while (i + 3 <= size)
+		{
+			size_t bestLength = 0;
+			size_t bestDistance = 0;
+			size_t limit = std::min(maxMatch, size - i);
+			size_t candidate = head[hash(i)];
+			for (int steps = 0; candidate != none && i - candidate <= windowSize && steps < maxChain; steps++)
+			{
+				size_t length = 0;
+				while (length < limit && data[candidate + length] == data[i + length]) length++;
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = i - candidate;
+					if (length == limit) break;
+				}
+				//slots older than the window may have been reused by a newer position
+				size_t next = previous[candidate % windowSize];
+				if (next == none || next >= candidate) break;
+				candidate = next;
+			}
+			insert(i);
+			if (bestLength >= 3)
+			{
+				WriteMatch(bits, int(bestLength), int(bestDistance));
+				for (size_t k = 1; k < bestLength && i + k + 3 <= size; k++) insert(i + k);
+				i += bestLength;
+			}
+			else WriteLiteral(bits, data[i++]);
+		}
+		while (i < size) WriteLiteral(bits, data[i++]);
+		WriteLiteral(bits, 256);
+		bits.Flush();
+
+		uint32_t a = 1, b = 0;
+		for (size_t k = 0; k < size; k++)
+		{
+			a = (a + data[k]) % 65521;
+			b = (b + a) % 65521;
+		}
+		uint32_t adler = (b << 16) | a;
+		out.push_back((unsigned char)(adler >> 24));
+		out.push_back((unsigned char)(adler >> 16));
+		out.push_back((unsigned char)(adler >> 8));
+		out.push_back((unsigned char)(adler));
+		return out;
+	}
+}
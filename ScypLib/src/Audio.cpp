@@ -23,7 +23,9 @@ namespace sl
     {
         if (!sounds.contains(filepath))
         {
-            sounds[filepath] = std::make_unique<Sound>(&soundEngine, filepath);
+            AssetPack::Asset asset;
+            if (assetPack && assetPack->Read(filepath, asset)) sounds[filepath] = std::make_unique<Sound>(&soundEngine, std::move(asset), filepath);
+            else sounds[filepath] = std::make_unique<Sound>(&soundEngine, filepath);
         }
         return sounds[filepath].get();
     }
@@ -64,7 +66,21 @@ namespace sl
         {
             throw std::runtime_error(("Failed to init decoder: " + filepath).c_str());
         }
+        Init(engine, filepath);
+    }
+
+    Sound::Sound(ma_engine* engine, AssetPack::Asset&& asset, const std::string& filepath)
+        : asset(std::move(asset))
+    {
+        if (ma_decoder_init_memory(this->asset.GetData(), this->asset.GetSize(), nullptr, &decoder) != MA_SUCCESS)
+        {
+            throw std::runtime_error(("Failed to init decoder: " + filepath).c_str());
+        }
+        Init(engine, filepath);
+    }
 
+    void Sound::Init(ma_engine* engine, const std::string& filepath)
+    {
         if (ma_sound_init_from_data_source(engine, &decoder, 0, nullptr, &sound) != MA_SUCCESS)
         {
             throw std::runtime_error(("Failed to init sound: " + filepath).c_str());
@@ -0,0 +1,204 @@
+#include<cassert>
+#include<algorithm>
+
+#include<GL/glew.h>
+
+#include"ScypLib/DynamicFont.h"
+
+namespace sl
+{
+	DynamicFont::DynamicFont(std::vector<unsigned char>&& ttfBuffer, int pageSize, int maxPages, bool signedDistanceField)
+		: ttfBuffer(std::move(ttfBuffer)), pageSize(pageSize), maxPages(maxPages), signedDistanceField(signedDistanceField)
+	{
+		assert(maxPages > 0 && pageSize > 0);
+		int initialized = stbtt_InitFont(&info, this->ttfBuffer.data(), stbtt_GetFontOffsetForIndex(this->ttfBuffer.data(), 0));
+		assert(initialized && "Failed to load dynamic font. Font data is invalid");
+		stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+	}
+
+	const DynamicFont::Glyph* DynamicFont::GetGlyph(unsigned int codepoint, int pixelSize)
+	{
+		if (signedDistanceField) pixelSize = sdfPixelSize;
+		unsigned long long key = (static_cast<unsigned long long>(pixelSize) << 32) | codepoint;
+		auto it = glyphs.find(key);
+		if (it == glyphs.end()) return Rasterize(key, codepoint, pixelSize);
+		if (it->second.pageIndex != -1)
+		{
+			Page& page = pages[it->second.pageIndex];
+			if (page.lastUsedFrame != frameIndex)
+			{
+				page.lastUsedFrame = frameIndex;
+				pageLRU.Push(it->second.pageIndex);
+			}
+		}
+		return &it->second;
+	}
+
+	float DynamicFont::GetKerning(unsigned int left, unsigned int right, int pixelSize) const
+	{
+		return stbtt_GetCodepointKernAdvance(&info, int(left), int(right)) * stbtt_ScaleForPixelHeight(&info, float(pixelSize));
+	}
+
+	float DynamicFont::GetAscent(int pixelSize) const
+	{
+		return ascent * stbtt_ScaleForPixelHeight(&info, float(pixelSize));
+	}
+
+	float DynamicFont::GetLineHeight(int pixelSize) const
+	{
+		return (ascent - descent + lineGap) * stbtt_ScaleForPixelHeight(&info, float(pixelSize));
+	}
+
+	unsigned int DynamicFont::NextCodepoint(const std::string& text, size_t& index)
+	{
+		unsigned char lead = (unsigned char)text[index++];
+		if (lead < 0x80) return lead;
+		int length = 0;
+		unsigned int codepoint = 0;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			length = 1;
+			codepoint = lead & 0x1F;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 2;
+			codepoint = lead & 0x0F;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			length = 3;
+			codepoint = lead & 0x07;
+		}
+		else return 0xFFFD;
+		for (int i = 0; i < length; i++)
+		{
+			if (index >= text.size() || ((unsigned char)text[index] & 0xC0) != 0x80) return 0xFFFD;
+			codepoint = (codepoint << 6) | ((unsigned char)text[index++] & 0x3F);
+		}
+		return codepoint;
+	}
+
+	const DynamicFont::Glyph* DynamicFont::Rasterize(unsigned long long key, unsigned int codepoint, int pixelSize)
+	{
+		float scale = stbtt_ScaleForPixelHeight(&info, float(pixelSize));
+		int advance, leftBearing;
+		stbtt_GetCodepointHMetrics(&info, int(codepoint), &advance, &leftBearing);
+		int width = 0, height = 0;
+		int xOffset = 0, yOffset = 0;
+		if (signedDistanceField)
+		{
+			//the outline sits at 0.5, the spread maps to the remaining half of the range on each side
+			unsigned char* sdf = stbtt_GetCodepointSDF(&info, scale, int(codepoint), sdfSpread, 128, 128.0f / float(sdfSpread), &width, &height, &xOffset, &yOffset);
+			if (sdf)
+			{
+				rasterBuffer.assign(sdf, sdf + size_t(width) * height);
+				stbtt_FreeSDF(sdf, nullptr);
+			}
+			else width = height = 0;
+		}
+		else
+		{
+			int x1, y1;
+			stbtt_GetCodepointBitmapBox(&info, int(codepoint), scale, scale, &xOffset, &yOffset, &x1, &y1);
+			width = x1 - xOffset;
+			height = y1 - yOffset;
+		}
+
+		Glyph glyph;
+		glyph.advance = advance * scale;
+		glyph.offset = Vec2f(float(xOffset), float(yOffset));
+		glyph.size = Vec2f(float(width), float(height));
+		//whitespace only advances the pen and never takes atlas space
+		if (width <= 0 || height <= 0) return &(glyphs[key] = glyph);
+		if (width + 2 * padding > pageSize || height + 2 * padding > pageSize) return nullptr;
+
+		int x = 0, y = 0;
+		int pageIndex = -1;
+		for (int i = 0; i < int(pages.size()) && pageIndex == -1; i++)
+		{
+			if (Allocate(pages[i], width, height, x, y)) pageIndex = i;
+		}
+		if (pageIndex == -1)
+		{
+			pageIndex = int(pages.size()) < maxPages ? AddPage() : EvictPage();
+			if (pageIndex == -1 || !Allocate(pages[pageIndex], width, height, x, y)) return nullptr;
+		}
+		Page& page = pages[pageIndex];
+
+		if (!signedDistanceField)
+		{
+			rasterBuffer.resize(size_t(width) * height);
+			stbtt_MakeCodepointBitmap(&info, rasterBuffer.data(), width, height, width, scale, scale, int(codepoint));
+		}
+		uploadBuffer.resize(rasterBuffer.size() * 4);
+		for (size_t i = 0; i < rasterBuffer.size(); i++)
+		{
+			uploadBuffer[i * 4 + 0] = 255;
+			uploadBuffer[i * 4 + 1] = 255;
+			uploadBuffer[i * 4 + 2] = 255;
+			uploadBuffer[i * 4 + 3] = rasterBuffer[i];
+		}
+		page.texture->Update(x, y, width, height, 4, uploadBuffer.data());
+
+		//same orientation as the baked atlases, the bitmap's first row is the glyph's top
+		float size = float(pageSize);
+		glyph.uv = RectF(x / size, (x + width) / size, (y + height) / size, y / size);
+		glyph.page = page.texture.get();
+		glyph.pageIndex = pageIndex;
+		page.keys.push_back(key);
+		page.lastUsedFrame = frameIndex;
+		pageLRU.Push(pageIndex);
+		return &(glyphs[key] = glyph);
+	}
+
+	bool DynamicFont::Allocate(Page& page, int width, int height, int& x, int& y)
+	{
+		int paddedWidth = width + padding;
+		int paddedHeight = height + padding;
+		//first shelf tall enough without wasting more than a third of its height
+		for (Shelf& shelf : page.shelves)
+		{
+			if (paddedHeight <= shelf.height && paddedHeight * 3 >= shelf.height * 2 && shelf.x + paddedWidth <= pageSize)
+			{
+				x = shelf.x;
+				y = shelf.y;
+				shelf.x += paddedWidth;
+				return true;
+			}
+		}
+		if (page.nextShelfY + paddedHeight > pageSize || padding + paddedWidth > pageSize) return false;
+		page.shelves.push_back(Shelf{ page.nextShelfY, paddedHeight, padding + paddedWidth });
+		x = padding;
+		y = page.nextShelfY;
+		page.nextShelfY += paddedHeight;
+		return true;
+	}
+
+	int DynamicFont::AddPage()
+	{
+		Page page;
+		page.texture = std::make_unique<Texture>(pageSize, pageSize, 4, nullptr, TextureWrap::ClampToEdge, TextureFilter::Linear, TextureFilter::Linear);
+		//padding between glyphs has to be transparent for linear filtering
+		glClearTexImage(page.texture->GetHandle(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		page.nextShelfY = padding;
+		pages.push_back(std::move(page));
+		return int(pages.size() - 1);
+	}
+
+	int DynamicFont::EvictPage()
+	{
+		int pageIndex = pageLRU.GetLRU();
+		Page& page = pages[pageIndex];
+		//glyphs of this frame are already queued with their uvs, clearing their page would corrupt them
+		if (page.lastUsedFrame == frameIndex) return -1;
+		pageLRU.Erase(pageIndex);
+		for (unsigned long long key : page.keys) glyphs.erase(key);
+		page.keys.clear();
+		page.shelves.clear();
+		page.nextShelfY = padding;
+		glClearTexImage(page.texture->GetHandle(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		evictions++;
+		return pageIndex;
+	}
+}
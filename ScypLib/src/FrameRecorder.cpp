@@ -0,0 +1,211 @@
+#include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<algorithm>
+#include<filesystem>
+
+#include"ScypLib/AssetPack.h"
+#include"ScypLib/FrameRecorder.h"
+
+namespace sl
+{
+	namespace
+	{
+		uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+		{
+			static const std::vector<uint32_t> table = []()
+				{
+					std::vector<uint32_t> table(256);
+					for (uint32_t i = 0; i < 256; i++)
+					{
+						uint32_t c = i;
+						for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+						table[i] = c;
+					}
+					return table;
+				}();
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		void WriteBigEndian(FILE* file, uint32_t value)
+		{
+			unsigned char bytes[4] = { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)(value) };
+			fwrite(bytes, 1, 4, file);
+		}
+
+		void WriteChunk(FILE* file, const char* type, const unsigned char* data, size_t size)
+		{
+			WriteBigEndian(file, uint32_t(size));
+			fwrite(type, 1, 4, file);
+			if (size) fwrite(data, 1, size, file);
+			WriteBigEndian(file, Crc32(data, size, Crc32((const unsigned char*)type, 4)));
+		}
+	}
+
+	FrameRecorder::FrameRecorder(const std::string& directory, FrameFormat format, int latency, size_t maxQueuedFrames)
+		: directory(directory), format(format), maxQueuedFrames(std::max<size_t>(maxQueuedFrames, 1)), readback(std::max(latency, 1) + 1)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		writer = std::thread(&FrameRecorder::WriterLoop, this);
+	}
+
+	FrameRecorder::~FrameRecorder()
+	{
+		CollectFrames(true);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		writer.join();
+	}
+
+	void FrameRecorder::Capture(unsigned int framebuffer, int width, int height)
+	{
+		CollectFrames(false);
+		if (paused) return;
+		//the ring reuses the oldest slot when the gpu is behind, that frame is counted when it turns up missing
+		pending.push_back(Pending{ frameNumber++, readback.Request(framebuffer, height, 0, 0, width, height) });
+	}
+
+	size_t FrameRecorder::GetDroppedFrames() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return dropped;
+	}
+
+	size_t FrameRecorder::GetWrittenFrames() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return written;
+	}
+
+	size_t FrameRecorder::GetFailedWrites() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return failed;
+	}
+
+	void FrameRecorder::CollectFrames(bool wait)
+	{
+		while (!pending.empty())
+		{
+			Pending next = pending.front();
+			if (!readback.IsPending(next.ticket))
+			{
+				pending.pop_front();
+				std::lock_guard<std::mutex> lock(mutex);
+				dropped++;
+				continue;
+			}
+			if (!wait && !readback.IsReady(next.ticket)) return;
+
+			Frame frame;
+			frame.number = next.number;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!freeFrames.empty())
+				{
+					frame.pixels = std::move(freeFrames.back());
+					freeFrames.pop_back();
+				}
+			}
+			//the copy has to leave the buffer on the render thread, the slot is reused by a later frame
+			if (wait) readback.Wait(next.ticket, frame.pixels);
+			else readback.Collect(next.ticket, frame.pixels);
+			pending.pop_front();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (queue.size() >= maxQueuedFrames && !wait)
+				{
+					dropped++;
+					freeFrames.push_back(std::move(frame.pixels));
+					continue;
+				}
+				queue.push_back(std::move(frame));
+			}
+			condition.notify_one();
+		}
+	}
+
+	void FrameRecorder::WriterLoop()
+	{
+		std::vector<unsigned char> scratch;
+		while (true)
+		{
+			Frame frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) return;
+				frame = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			bool ok = WriteFrame(frame, scratch);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (ok) written++;
+			else failed++;
+			freeFrames.push_back(std::move(frame.pixels));
+		}
+	}
+
+	bool FrameRecorder::WriteFrame(const Frame& frame, std::vector<unsigned char>& scratch) const
+	{
+		const PixelRegion& pixels = frame.pixels;
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%06zu.%s", frame.number, format == FrameFormat::Png ? "png" : "pam");
+		std::string path = (std::filesystem::path(directory) / name).string();
+
+		FILE* file = nullptr;
+		fopen_s(&file, path.c_str(), "wb");
+		if (!file) return false;
+
+		size_t rowSize = size_t(pixels.width) * 4;
+		if (format == FrameFormat::Raw)
+		{
+			fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", pixels.width, pixels.height);
+			fwrite(pixels.pixels.data(), 1, rowSize * pixels.height, file);
+		}
+		else
+		{
+			//every row uses the up filter, the difference to the row above compresses far better than the raw colors
+			scratch.resize((rowSize + 1) * pixels.height);
+			for (int y = 0; y < pixels.height; y++)
+			{
+				const unsigned char* row = pixels.pixels.data() + rowSize * y;
+				unsigned char* out = scratch.data() + (rowSize + 1) * y;
+				out[0] = y > 0 ? 2 : 0;
+				if (y == 0)
+				{
+					memcpy(out + 1, row, rowSize);
+					continue;
+				}
+				const unsigned char* previous = row - rowSize;
+				for (size_t x = 0; x < rowSize; x++) out[x + 1] = (unsigned char)(row[x] - previous[x]);
+			}
+			std::vector<unsigned char> data = AssetPack::Deflate(scratch.data(), scratch.size());
+
+			const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			fwrite(signature, 1, sizeof(signature), file);
+			unsigned char header[13] = {};
+			for (int i = 0; i < 4; i++)
+			{
+				header[i] = (unsigned char)(uint32_t(pixels.width) >> (24 - i * 8));
+				header[4 + i] = (unsigned char)(uint32_t(pixels.height) >> (24 - i * 8));
+			}
+			header[8] = 8;//bit depth
+			header[9] = 6;//rgba
+			WriteChunk(file, "IHDR", header, sizeof(header));
+			WriteChunk(file, "IDAT", data.data(), data.size());
+			WriteChunk(file, "IEND", nullptr, 0);
+		}
+		bool ok = !ferror(file);
+		fclose(file);
+		return ok;
+	}
+}
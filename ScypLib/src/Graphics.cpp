@@ -1,18 +1,46 @@
 #include<glm/glm.hpp>
 #include<glm/gtc/type_ptr.hpp>
 
+#include"stb/stb_image.h"
+
 #include"ScypLib/Graphics.h"
 
 namespace sl
 {
+	namespace
+	{
+		//covers the viewport with one triangle, the corners outside of it are clipped
+		const char* postProcessVertexShader = R"(
+			#version 450 core
+			
+			out vec2 vTexCoord;
+			
+			void main()
+			{
+			    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+			    vTexCoord = corner;
+			    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+			}
+			)";
+	}
+
 	Graphics::Graphics(Window* wnd)
 		: Graphics(wnd, float(wnd->GetWidth()), float(wnd->GetHeight())) {}
 
-	Graphics::Graphics(Window* wnd, float canvasWidth, float canvasHeight)
+	Graphics::Graphics(Window* wnd, float canvasWidth, float canvasHeight, const std::string& shaderCacheDirectory)
 		: window(wnd), canvasWidth(canvasWidth), canvasHeight(canvasHeight)
 	{
+		SetShaderCache(shaderCacheDirectory);
 		glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextureSlots);
-		for (int i = 0; i < maxTextureSlots; i++) availableSlots.insert(i);
+		//the top units are reserved for texture array pages, the rest are plain 2d slots
+		maxTextureSlots = std::min(maxTextureSlots, 32) - textureArraySlotCount;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &textureArrayPageLayers);
+		textureArrayPageLayers = std::min(textureArrayPageLayers, 256);
+		textureArraySlots.resize(textureArraySlotCount, nullptr);
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboOffsetAlignment);
+		//the last 2d slot and the last array slot are kept out of the lru for tilemap chunks, see DrawTilemapChunk
+		retainedTextureSlot = maxTextureSlots - 1;
+		for (int i = 0; i < retainedTextureSlot; i++) availableSlots.insert(i);
 		SetVSyncInterval(1);
 		unsigned char whiteTexture[3] = { 255,255,255 };
 		blankTexture = CreateTextureFromMemory(1, 1, 3, whiteTexture, TextureWrap::ClampToEdge, TextureFilter::Nearest, TextureFilter::Nearest);
@@ -20,16 +48,16 @@ namespace sl
 		const std::string vertexShader = R"(
 			#version 450 core
 			
-			layout(location = 0) in vec3 aPosition;
-			layout(location = 1) in vec2 aTexCoord;
-			layout(location = 2) in float aInstanceIndex;
-			
 			struct InstanceData 
 			{
-			    mat4 transform;
-			    vec4 colorTint;
-			    float textureSlot;
-			    float padding[3];
+			    vec2 position;
+			    vec2 size;
+			    vec2 origin;
+			    uint rotation;
+			    float layer;
+			    uint color;
+			    uint textureSlot;
+			    uvec2 uv;
 			};
 			
 			layout(std140, binding = 0) uniform CameraBuffer 
@@ -43,67 +71,130 @@ namespace sl
 			    InstanceData instances[];
 			};
 			
+			layout(std430, binding = 2) readonly buffer transformData
+			{
+			    mat4 transforms[];
+			};
+			
 			out vec2 vTexCoord;
 			out float vTexSlot;
 			out vec4 vColorTint;
 			
+			const vec2 corners[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+			
 			void main()
 			{
-			    InstanceData data = instances[int(aInstanceIndex)];
-			    gl_Position = projection * view * data.transform * vec4(aPosition, 1.0);
+			    InstanceData data = instances[gl_VertexID >> 2];
+			    vec2 corner = corners[gl_VertexID & 3];
+			    vec2 rotation = unpackSnorm2x16(data.rotation);
+			    vec2 local = corner * data.size - data.origin;
+			    vec2 position = data.position + data.origin + vec2(rotation.y * local.x - rotation.x * local.y, rotation.x * local.x + rotation.y * local.y);
+			    vec4 world = vec4(position, data.layer, 1.0);
+			    uint transformIndex = (data.textureSlot >> 16) & 0x7FFFu;
+			    if (transformIndex != 0u) world = transforms[transformIndex - 1u] * world;
+			    gl_Position = projection * view * world;
 			
-			    vTexCoord = aTexCoord;
-			    vTexSlot = data.textureSlot;
-			    vColorTint = data.colorTint;
+			    bool halfUV = (data.textureSlot & 0x80000000u) != 0u;
+			    vec2 uvX = halfUV ? unpackHalf2x16(data.uv.x) : unpackUnorm2x16(data.uv.x);
+			    vec2 uvY = halfUV ? unpackHalf2x16(data.uv.y) : unpackUnorm2x16(data.uv.y);
+			    vTexCoord = vec2(mix(uvX.x, uvX.y, corner.x), mix(uvY.y, uvY.x, corner.y));
+			    vTexSlot = float(data.textureSlot & 0xFFFFu);
+			    vColorTint = unpackUnorm4x8(data.color);
 			}
 			)";
-		const std::string fragmentShader = R"(
-			#version 450 core
-			
+		const std::string fragmentShader = "#version 450 core\n"
+			"#define TEXTURE_SLOTS " + std::to_string(maxTextureSlots) + "\n"
+			"#define TEXTURE_ARRAY_SLOTS " + std::to_string(textureArraySlotCount) + "\n" + R"(
 			in vec2 vTexCoord;
 			in float vTexSlot;
 			in vec4 vColorTint;
 			
 			out vec4 FragColor;
-			uniform sampler2D uTextures[32];
+			uniform sampler2D uTextures[TEXTURE_SLOTS];
+			uniform sampler2DArray uTextureArrays[TEXTURE_ARRAY_SLOTS];
 			
 			void main()
 			{
+			#ifdef SOLID_COLOR
+			    vec4 finalColor = vColorTint;
+			#else
 			    int slot = int(vTexSlot);
-			    vec4 texColor = texture(uTextures[slot], vTexCoord);
+			    vec4 texColor;
+			    if (slot >= 0x8000) texColor = texture(uTextureArrays[(slot >> 11) & 0xF], vec3(vTexCoord, float(slot & 0x7FF)));
+			    else texColor = texture(uTextures[slot], vTexCoord);
+			#ifdef UNTINTED
+			    vec4 finalColor = texColor;
+			#else
 			    vec4 finalColor = texColor * vColorTint;
+			#endif
+			#endif
 			
+			    //the alpha test turns off early depth rejection, opaque batches use the NO_DISCARD variant
+			#ifndef NO_DISCARD
 			    if (finalColor.a < 0.1) discard;
+			#endif
 			
 			    FragColor = finalColor;
 			}
 			)";
 
+		//alpha holds the distance to the outline, fwidth keeps the edge one screen pixel wide at any scale
+		const std::string sdfTextFragmentShader = "#version 450 core\n"
+			"#define TEXTURE_SLOTS " + std::to_string(maxTextureSlots) + "\n"
+			"#define TEXTURE_ARRAY_SLOTS " + std::to_string(textureArraySlotCount) + "\n" + R"(
+			in vec2 vTexCoord;
+			in float vTexSlot;
+			in vec4 vColorTint;
+			
+			out vec4 FragColor;
+			uniform sampler2D uTextures[TEXTURE_SLOTS];
+			uniform sampler2DArray uTextureArrays[TEXTURE_ARRAY_SLOTS];
+			
+			void main()
+			{
+			    int slot = int(vTexSlot);
+			    float distance;
+			    if (slot >= 0x8000) distance = texture(uTextureArrays[(slot >> 11) & 0xF], vec3(vTexCoord, float(slot & 0x7FF))).a;
+			    else distance = texture(uTextures[slot], vTexCoord).a;
+			    float edge = max(fwidth(distance), 0.0001);
+			    float coverage = smoothstep(0.5 - edge, 0.5 + edge, distance);
+			
+			    if (coverage * vColorTint.a < 0.01) discard;
+			
+			    FragColor = vec4(vColorTint.rgb, vColorTint.a * coverage);
+			}
+			)";
+
 		builtInShader = LoadShader(vertexShader, fragmentShader, false);
+		sdfTextShader = LoadShader(vertexShader, sdfTextFragmentShader, false);
 		SetDefaultShader(builtInShader);
 
 		glGenVertexArrays(1, &vao);
 		BindVertexArray(vao);
-		glGenBuffers(1, &vbo);
-		BindVertexBuffer(vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(TextureVertex) * unsigned int(maxQuadsInBatch * 4), nullptr, GL_DYNAMIC_DRAW);
-		unsigned int offset = 0;
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (void*)offset);
-		glEnableVertexAttribArray(0);
-		offset += 3 * sizeof(float);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (void*)offset);
-		glEnableVertexAttribArray(1);
-		offset += 2 * sizeof(float);
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (void*)offset);
-		glEnableVertexAttribArray(2);
+		std::vector<unsigned int> quadIndices(6 * maxQuadsInBatch);
+		for (unsigned int quad = 0; quad < unsigned int(maxQuadsInBatch); quad++)
+		{
+			unsigned int vertStart = quad * 4;
+			unsigned int* index = &quadIndices[quad * 6];
+			index[0] = vertStart;
+			index[1] = vertStart + 1;
+			index[2] = vertStart + 2;
+			index[3] = vertStart;
+			index[4] = vertStart + 2;
+			index[5] = vertStart + 3;
+		}
 		glGenBuffers(1, &ibo);
 		BindIndexBuffer(ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * unsigned int(6 * maxQuadsInBatch), nullptr, GL_DYNAMIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * quadIndices.size(), quadIndices.data(), GL_STATIC_DRAW);
 
 		glGenBuffers(1, &instanceSSBO);
 		BindShaderStorageBuffer(instanceSSBO);
 		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(InstanceData) * unsigned int(maxQuadsInBatch), nullptr, GL_DYNAMIC_DRAW);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceSSBOBindingPoint, instanceSSBO);
+		glGenBuffers(1, &transformSSBO);
+		BindShaderStorageBuffer(transformSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * unsigned int(maxQuadsInBatch), nullptr, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, transformSSBOBindingPoint, transformSSBO);
 		glGenBuffers(1, &vpMatUbo);
 		BindUniformBuffer(vpMatUbo);
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewProjMat), &vpMat, GL_DYNAMIC_DRAW);
@@ -112,99 +203,130 @@ namespace sl
 		SetCanvasSize(Vec2f(1.0f, 1.0f));//SMTHING BUGGER IF CALLED TWICE IT WORKS PROPERLY OR OUTSIDE OF CONSTRUCTOR
 		SetCanvasSize(Vec2f(float(wnd->GetWidth()), float(wnd->GetHeight())));
 
-		vertices.reserve(maxQuadsInBatch * 4);
-		indices.reserve(6 * maxQuadsInBatch);
-	}
-
-	Graphics::TextureVertex::TextureVertex(float x, float y, float z, float u, float v, int instanceIndex)
-		: x(x), y(y), z(z), u(u), v(v), instanceIndex(static_cast<float>(instanceIndex)) {}
-
-	bool Graphics::TextureVertex::operator==(const TextureVertex& other) const
-	{
-		return x == other.x && y == other.y &&
-			z == other.z &&
-			u == other.u && v == other.v &&
-			instanceIndex == other.instanceIndex;
+		instanceDataBuffer.reserve(maxQuadsInBatch);
+		transformBuffer.reserve(maxQuadsInBatch);
+		usedTextures.reserve(maxTextureSlots);
+		renderQueue.Reserve(maxQuadsInBatch);
 	}
 
-	size_t Graphics::TextureVertex::Hasher::operator()(const TextureVertex& vertex) const
+	Graphics::InstanceData::InstanceData(const Renderable& renderable, int textureSlot, int transformIndex)
+		: position(renderable.x, renderable.y), size(renderable.width, renderable.height), origin(renderable.origin.x, renderable.origin.y), layer(renderable.z)
 	{
-		size_t seed = 0;
-		auto hash_combine = [&seed](size_t h)
-			{
-				seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-			};
-
-		hash_combine(std::hash<float>{}(vertex.x));
-		hash_combine(std::hash<float>{}(vertex.y));
-		hash_combine(std::hash<float>{}(vertex.z));
-		hash_combine(std::hash<float>{}(vertex.u));
-		hash_combine(std::hash<float>{}(vertex.v));
-		hash_combine(std::hash<float>{}(vertex.instanceIndex));
-
-		return seed;
+		const Color& c = renderable.color;
+		const RectF uv = renderable.texture->MapUV(renderable.uv);
+		rotation = glm::packSnorm2x16(glm::vec2(std::sin(renderable.angle), std::cos(renderable.angle)));
+		color = glm::packUnorm4x8(glm::vec4(c.r, c.g, c.b, c.a));
+		this->textureSlot = (unsigned int(transformIndex + 1) << 16) | (unsigned int(textureSlot) & 0xFFFFu);
+		bool inRange = std::min({ uv.left, uv.right, uv.top, uv.bottom }) >= 0.0f && std::max({ uv.left, uv.right, uv.top, uv.bottom }) <= 1.0f;
+		if (inRange)
+		{
+			this->uv[0] = glm::packUnorm2x16(glm::vec2(uv.left, uv.right));
+			this->uv[1] = glm::packUnorm2x16(glm::vec2(uv.top, uv.bottom));
+		}
+		else
+		{
+			//unorm16 would clamp a tiling rect to a single repeat
+			this->textureSlot |= 0x80000000u;
+			this->uv[0] = glm::packHalf2x16(glm::vec2(uv.left, uv.right));
+			this->uv[1] = glm::packHalf2x16(glm::vec2(uv.top, uv.bottom));
+		}
 	}
 
-	Graphics::InstanceData::InstanceData(glm::mat4 transform, Color color, float textureSlot)
-		: transform(transform), color(color), textureSlot(textureSlot) {}
-
-	Graphics::Renderable::Renderable(float x, float y, float z, float width, float height, RectF uv, const Texture* texture, glm::mat4 transform, Color color)
-		: x(x), y(y), z(z), width(width), height(height), uv(uv), texture(texture), data(transform, color, -1.0f) {}
+	Graphics::Renderable::Renderable(float x, float y, float z, float width, float height, RectF uv, const Texture* texture, Shader* shader, Color color, float angle, Vec2f origin)
+		: x(x), y(y), z(z), width(width), height(height), angle(angle), origin(origin), texture(texture), shader(shader), color(color), uv(uv) {}
 
 	Graphics::~Graphics()
 	{
 		glDeleteFramebuffers(1, &fbo);
 		glDeleteRenderbuffers(1, &rbo);
 		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(1, &vbo);
+		streamBuffer.reset();
 		glDeleteBuffers(1, &ibo);
 		glDeleteBuffers(1, &instanceSSBO);
+		glDeleteBuffers(1, &transformSSBO);
 		glDeleteBuffers(1, &vpMatUbo);
+		for (std::vector<unsigned int>& queries : postProcessQueries)
+		{
+			if (!queries.empty()) glDeleteQueries(GLsizei(queries.size()), queries.data());
+		}
+		if (linearSampler) glDeleteSamplers(1, &linearSampler);
+		if (nearestSampler) glDeleteSamplers(1, &nearestSampler);
+		textureLoader.reset();
+		if (uploadPBO) glDeleteBuffers(1, &uploadPBO);
 		ClearTextures();
 	}
 
 	void Graphics::BeginFrame()
 	{
+		stats = RenderStats{};
+		stats.readbacksDropped = readback.GetDropped();
+		stats.streamStalls = streamBuffer ? streamBuffer->GetStalls() : 0;
+		frameIndex++;
+		ExpireTextRuns();
+		ProcessTextureUploads();
+		for (auto& [path, font] : dynamicFonts) font->NextFrame();
+		renderTargets.Trim(frameIndex, 60);
 		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 		glViewport(0, 0, canvasWidth, canvasHeight);
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glClear(canvasDepth ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT);
 	}
 
 	void Graphics::EndFrame(Shader* shader)
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, window->GetWidth(), window->GetHeight());
-		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		glDisable(GL_DEPTH_TEST);
-		if (!shader) shader = defaultShader;
-		DrawTexture(GetCanvasRect(), framebufferTexture, shader);
-		Render();
+		Present(shader);
+		if (frameRecorder) frameRecorder->Capture(fbo, int(canvasWidth), int(canvasHeight));
 		glfwSwapBuffers(window->GetGLFWWindow());
-		glEnable(GL_DEPTH_TEST);
+		if (streamBuffer) streamBuffer->EndFrame();
 	}
 
 	void Graphics::EndFrame(std::vector<Shader*>& shaders)
 	{
 		ApplyPostProcessing(shaders);
-		glDisable(GL_DEPTH_TEST);
+		Present(nullptr);
+		if (frameRecorder) frameRecorder->Capture(fbo, int(canvasWidth), int(canvasHeight));
+		glfwSwapBuffers(window->GetGLFWWindow());
+		if (streamBuffer) streamBuffer->EndFrame();
+	}
+
+	void Graphics::Present(Shader* shader)
+	{
+		RectI rect = GetPresentRect();
+		int windowHeight = window->GetHeight();
+		if (!shader && !viewPresentQueued)
+		{
+			//draws still queued belong to the canvas, then it is copied over without touching the batch
+			Render();
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			if (rect.left > 0 || rect.top > 0 || rect.right < window->GetWidth() || rect.bottom < windowHeight)
+			{
+				glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+				glClear(GL_COLOR_BUFFER_BIT);
+			}
+			glBlitNamedFramebuffer(fbo, 0, 0, 0, int(canvasWidth), int(canvasHeight),
+				rect.left, windowHeight - rect.bottom, rect.right, windowHeight - rect.top, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			return;
+		}
+
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, window->GetWidth(), window->GetHeight());
+		glViewport(rect.left, windowHeight - rect.bottom, rect.GetWidth(), rect.GetHeight());
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		DrawTexture(GetCanvasRect(), framebufferTexture, defaultShader);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_DEPTH_TEST);
+		if (shader) DrawTexture(GetCanvasRect(), framebufferTexture, shader);
 		Render();
-		glfwSwapBuffers(window->GetGLFWWindow());
 		glEnable(GL_DEPTH_TEST);
+		viewPresentQueued = false;
 	}
 
 	void Graphics::BeginView(Vec2f cameraPosition, float zoom)
 	{
+		viewPosition = cameraPosition;
+		viewZoom = zoom;
 		vpMat.view = glm::mat4(1.0f);
 		vpMat.view = glm::scale(vpMat.view, glm::vec3(zoom, zoom, 1.0f));
 		vpMat.view = glm::translate(vpMat.view, glm::vec3(-cameraPosition.x, -cameraPosition.y, 0.0f));
-		BindUniformBuffer(vpMatUbo);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(vpMat), &vpMat);
+		glNamedBufferSubData(vpMatUbo, 0, sizeof(vpMat), &vpMat);
 	}
 
 	void Graphics::EndView(std::vector<Shader*>& shaders)
@@ -216,14 +338,15 @@ namespace sl
 	void Graphics::EndView(Shader* shader)
 	{
 		Render();
-		glDisable(GL_DEPTH_TEST);
-		if (!shader) shader = defaultShader;
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferTextureSecondary->GetHandle(), 0);
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferTexture->GetHandle(), 0);
+		if (!shader) return;
+		//drawn to the window by EndFrame, which then presents with this shader instead of a blit
 		DrawTexture(GetCanvasRect(), framebufferTexture, shader);
-		glEnable(GL_DEPTH_TEST);
+		viewPresentQueued = true;
+	}
+
+	void Graphics::SetCulling(bool enabled)
+	{
+		cullingEnabled = enabled;
 	}
 
 	void Graphics::SetDrawLayer(float layer)
@@ -246,11 +369,32 @@ namespace sl
 		UpdateCanvasSize(canvasWidth, height);
 	}
 
+	void Graphics::SetPresentScaling(PresentScaling scaling)
+	{
+		presentScaling = scaling;
+	}
+
 	void Graphics::SetVSyncInterval(int interval)
 	{
 		glfwSwapInterval(interval);
 	}
 
+	void Graphics::SetStreamingBuffers(bool enabled, int regionCount)
+	{
+		streamBuffer.reset();
+		if (!enabled || !StreamBuffer::IsSupported())
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, transformSSBOBindingPoint, transformSSBO);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceSSBOBindingPoint, instanceSSBO);
+			boundSSBO = instanceSSBO;
+			return;
+		}
+
+		//room for two full batches per region so a frame rarely has to rotate early
+		size_t regionSize = 2 * (maxQuadsInBatch * (sizeof(InstanceData) + sizeof(glm::mat4)) + 2 * size_t(ssboOffsetAlignment));
+		streamBuffer = std::make_unique<StreamBuffer>(regionSize, regionCount);
+	}
+
 	void Graphics::ApplyPostProcessing(std::vector<Shader*>& shaders)
 	{
 		glDisable(GL_DEPTH_TEST);
@@ -269,11 +413,121 @@ namespace sl
 		glEnable(GL_DEPTH_TEST);
 	}
 
+	void Graphics::ApplyPostProcessing(const std::vector<PostProcessPass>& passes)
+	{
+		if (passes.empty()) return;
+		Render();
+		glDisable(GL_DEPTH_TEST);
+		BindVertexArray(vao);
+		if (!linearSampler)
+		{
+			glCreateSamplers(1, &linearSampler);
+			glSamplerParameteri(linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glSamplerParameteri(linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glCreateSamplers(1, &nearestSampler);
+			glSamplerParameteri(nearestSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glSamplerParameteri(nearestSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			for (unsigned int sampler : { linearSampler, nearestSampler })
+			{
+				glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			}
+			postProcessQueries.resize(3);
+			postProcessQueryCounts.resize(3, 0);
+		}
+
+		//the set used three frames ago is normally done, reading it does not wait for the gpu
+		std::vector<unsigned int>& queries = postProcessQueries[frameIndex % postProcessQueries.size()];
+		size_t& queryCount = postProcessQueryCounts[frameIndex % postProcessQueries.size()];
+		int available = GL_FALSE;
+		if (queryCount > 0) glGetQueryObjectiv(queries[queryCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_TRUE)
+		{
+			postProcessTimings.resize(queryCount);
+			for (size_t i = 0; i < queryCount; i++)
+			{
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+				postProcessTimings[i] = float(double(nanoseconds) / 1000000.0);
+			}
+		}
+		if (queries.size() < passes.size())
+		{
+			size_t first = queries.size();
+			queries.resize(passes.size());
+			glCreateQueries(GL_TIME_ELAPSED, GLsizei(passes.size() - first), queries.data() + first);
+		}
+		queryCount = passes.size();
+
+		int sourceUnit = maxTextureSlots + textureArraySlotCount;
+		const RenderTargetPool::Target* source = nullptr;
+		unsigned int sourceTexture = framebufferTexture->GetHandle();
+		int sourceWidth = int(canvasWidth);
+		int sourceHeight = int(canvasHeight);
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			const PostProcessPass& pass = passes[i];
+			assert(pass.shader && "Failed to apply post processing. Pass shader is nullptr");
+			int width = int(canvasWidth);
+			int height = int(canvasHeight);
+			const RenderTargetPool::Target* target = nullptr;
+			//the last pass writes the second canvas texture, which then takes over as the canvas
+			if (i + 1 == passes.size())
+			{
+				glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, framebufferTextureSecondary->GetHandle(), 0);
+				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			}
+			else
+			{
+				width = std::max(1, int(canvasWidth * pass.scale));
+				height = std::max(1, int(canvasHeight * pass.scale));
+				target = renderTargets.Acquire(width, height, pass.format, frameIndex);
+				glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+			}
+			glViewport(0, 0, width, height);
+
+			unsigned int sampler = pass.filter == TextureFilter::Nearest ? nearestSampler : linearSampler;
+			glBindTextureUnit(sourceUnit, sourceTexture);
+			glBindTextureUnit(sourceUnit + 1, framebufferTexture->GetHandle());
+			glBindSampler(sourceUnit, sampler);
+			glBindSampler(sourceUnit + 1, sampler);
+			UniformHandle texelSize = pass.shader->GetUniform("uTexelSize");
+			if (texelSize.IsValid()) pass.shader->SetUniform(texelSize, glm::vec2(1.0f / float(sourceWidth), 1.0f / float(sourceHeight)));
+			BindShader(pass.shader->GetHandle());
+			pass.shader->UpdateUniformBuffers();
+			boundUBO = 0;//block buffers were bound through the generic target too
+
+			glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glEndQuery(GL_TIME_ELAPSED);
+			stats.drawCalls++;
+
+			if (source) renderTargets.Release(source);
+			source = target;
+			sourceTexture = target ? target->texture : 0;
+			sourceWidth = width;
+			sourceHeight = height;
+		}
+		glBindSampler(sourceUnit, 0);
+		glBindSampler(sourceUnit + 1, 0);
+
+		std::swap(framebufferTexture, framebufferTextureSecondary);
+		glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, framebufferTexture->GetHandle(), 0);
+		glViewport(0, 0, int(canvasWidth), int(canvasHeight));
+		glEnable(GL_DEPTH_TEST);
+	}
+
 	void Graphics::SetDefaultFont(Font* font)
 	{
 		defaultFont = font;
 	}
 
+	void Graphics::SetTextRunLifetime(size_t frames)
+	{
+		//runs drawn this frame must survive the next BeginFrame sweep
+		textRunLifetime = std::max<size_t>(frames, 1);
+	}
+
 	void Graphics::SetDefaultShader(Shader* shader)
 	{
 		if (!shader) defaultShader = builtInShader;
@@ -283,30 +537,20 @@ namespace sl
 	void Graphics::DrawTexture(float x, float y, const Texture* texture)
 	{
 		assert(texture && "Failed to draw texture. Texture is nullptr");
-		auto renderable = std::make_unique<Renderable>(x, y, curDrawLayer, float(texture->GetWidth()), float(texture->GetHeight()), RectF(0.0f, 1.0f, 0.0f, 1.0f),
-			texture, glm::mat4(1.0f), Colors::White);
-		if (texture->IsBinaryAlpha()) opaque[defaultShader].emplace_back(std::move(renderable));
-		else transparent[defaultShader].emplace_back(std::move(renderable));
+		Submit(Renderable(x, y, curDrawLayer, float(texture->GetWidth()), float(texture->GetHeight()), RectF(0.0f, 1.0f, 0.0f, 1.0f),
+			texture, defaultShader, Colors::White), texture->IsBinaryAlpha());
 	}
 
 	void Graphics::DrawTexture(Vec2f pos, Vec2f size, const Texture* texture, Shader* shader, bool flipX, bool flipY, float angle, Vec2f origin, const RectF* uv, const Color& tint)
 	{
 		assert(texture && "Failed to draw texture. Texture is nullptr");
 		RectF finalUV(0.0f, 1.0f, 0.0f, 1.0f);
-		glm::mat4 transform(1.0f);
 		if (!shader) shader = defaultShader;
 		if (uv) finalUV = *uv / Vec2f(float(texture->GetWidth()), float(texture->GetHeight()));
 		if (flipX) std::swap(finalUV.left, finalUV.right);
 		if (flipY) std::swap(finalUV.top, finalUV.bottom);
-		if (angle != 0)
-		{
-			transform = glm::translate(transform, glm::vec3(origin.x + pos.x, origin.y + pos.y, 0.0f));
-			transform = glm::rotate(transform, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
-			transform = glm::translate(transform, glm::vec3(-origin.x - pos.x, -origin.y - pos.y, 0.0f));
-		}
-		auto renderable = std::make_unique<Renderable>(pos.x, pos.y, curDrawLayer, size.x, size.y, finalUV, texture, transform, tint);
-		if (texture->IsBinaryAlpha() && (tint.a == 1.0f || tint.a == 0.0f)) opaque[shader].emplace_back(std::move(renderable));
-		else transparent[shader].emplace_back(std::move(renderable));
+		Submit(Renderable(pos.x, pos.y, curDrawLayer, size.x, size.y, finalUV, texture, shader, tint, glm::radians(angle), origin),
+			texture->IsBinaryAlpha() && (tint.a == 1.0f || tint.a == 0.0f));
 	}
 
 	void Graphics::DrawTexture(const RectF& targetRect, const Texture* texture, Shader* shader, bool flipX, bool flipY, float angle, Vec2f origin, const RectF* uv, const Color& tint)
@@ -314,52 +558,40 @@ namespace sl
 		DrawTexture({ targetRect.left, targetRect.top }, { targetRect.GetWidth(), targetRect.GetHeight() }, texture, shader, flipX, flipY, angle, origin, uv, tint);
 	}
 
+	void Graphics::DrawTexture(const glm::mat4& transform, const RectF& targetRect, const Texture* texture, Shader* shader, const RectF* uv, const Color& tint)
+	{
+		assert(texture && "Failed to draw texture. Texture is nullptr");
+		RectF finalUV(0.0f, 1.0f, 0.0f, 1.0f);
+		if (!shader) shader = defaultShader;
+		if (uv) finalUV = *uv / Vec2f(float(texture->GetWidth()), float(texture->GetHeight()));
+		Renderable renderable(targetRect.left, targetRect.top, curDrawLayer, targetRect.GetWidth(), targetRect.GetHeight(), finalUV, texture, shader, tint);
+		if (frameTransforms.size() == frameTransforms.capacity()) stats.commandBufferGrowths++;
+		renderable.transformIndex = int(frameTransforms.size());
+		frameTransforms.push_back(transform);
+		Submit(renderable, texture->IsBinaryAlpha() && (tint.a == 1.0f || tint.a == 0.0f));
+	}
+
 	void Graphics::DrawSprite(const Sprite& sprite)
 	{
 		assert(sprite.GetTexture() && "Failed to draw sprite. Texture is nullptr");
-		glm::mat4 transform(1.0f);
 		Vec2f pos = sprite.GetPos();
 		Vec2f size = sprite.GetSize();
 		Shader* shader = sprite.GetShader();
 		if (!shader) shader = defaultShader;
-		if (sprite.GetRotation() != 0)
-		{
-			Vec2f origin = sprite.GetOrigin();
-
-			transform = glm::translate(transform, glm::vec3(origin.x + pos.x, origin.y + pos.y, 0.0f));
-			transform = glm::rotate(transform, glm::radians(sprite.GetRotation()), glm::vec3(0.0f, 0.0f, 1.0f));
-			transform = glm::translate(transform, glm::vec3(-origin.x - pos.x, -origin.y - pos.y, 0.0f));
-		}
-		auto renderable = std::make_unique<Renderable>(pos.x, pos.y, curDrawLayer, size.x, size.y, sprite.GetNDCUV(), sprite.GetTexture(), transform, sprite.GetColorTint());
-
-		if (sprite.GetTexture()->IsBinaryAlpha() && (sprite.GetColorTint().a == 1.0f || sprite.GetColorTint().a == 0.0f)) opaque[shader].emplace_back(std::move(renderable));
-		else transparent[shader].emplace_back(std::move(renderable));
+		Submit(Renderable(pos.x, pos.y, curDrawLayer, size.x, size.y, sprite.GetNDCUV(), sprite.GetTexture(), shader, sprite.GetColorTint(), glm::radians(sprite.GetRotation()), sprite.GetOrigin()),
+			sprite.GetTexture()->IsBinaryAlpha() && (sprite.GetColorTint().a == 1.0f || sprite.GetColorTint().a == 0.0f));
 	}
 
 	void Graphics::DrawAnimatedSprite(const AnimatedSprite& animatedSprite)
 	{
 		assert(animatedSprite.GetTexture() && "Failed to draw sprite. Texture is nullptr");
-		glm::mat4 transform(1.0f);
 		Vec2f pos = animatedSprite.GetPos();
 		Vec2f size = animatedSprite.GetSize();
-		RectF uv = animatedSprite.GetNDCUV();
 		Shader* shader = animatedSprite.GetShader();
 		if (!shader) shader = defaultShader;
-		if (animatedSprite.IsFlippedX()) std::swap(uv.left, uv.right);
-		if (animatedSprite.IsFlippedY()) std::swap(uv.top, uv.bottom);
-
-		if (animatedSprite.GetRotation() != 0)
-		{
-			Vec2f origin = animatedSprite.GetOrigin();
-
-			transform = glm::translate(transform, glm::vec3(origin.x + pos.x, origin.y + pos.y, 0.0f));
-			transform = glm::rotate(transform, glm::radians(animatedSprite.GetRotation()), glm::vec3(0.0f, 0.0f, 1.0f));
-			transform = glm::translate(transform, glm::vec3(-origin.x - pos.x, -origin.y - pos.y, 0.0f));
-		}
-		auto renderable = std::make_unique<Renderable>(pos.x, pos.y, curDrawLayer, size.x, size.y, animatedSprite.GetNDCUV(), animatedSprite.GetTexture(), transform, animatedSprite.GetColorTint());
-
-		if (animatedSprite.GetTexture()->IsBinaryAlpha() && (animatedSprite.GetColorTint().a == 1.0f || animatedSprite.GetColorTint().a == 0.0f)) opaque[shader].emplace_back(std::move(renderable));
-		else transparent[shader].emplace_back(std::move(renderable));
+		Submit(Renderable(pos.x, pos.y, curDrawLayer, size.x, size.y, animatedSprite.GetNDCUV(), animatedSprite.GetTexture(), shader, animatedSprite.GetColorTint(),
+			glm::radians(animatedSprite.GetRotation()), animatedSprite.GetOrigin()),
+			animatedSprite.GetTexture()->IsBinaryAlpha() && (animatedSprite.GetColorTint().a == 1.0f || animatedSprite.GetColorTint().a == 0.0f));
 	}
 
 	void Graphics::DrawLine(float x1, float y1, float x2, float y2, float thickness, const Color& c, Shader* shader)
@@ -370,22 +602,15 @@ namespace sl
 		float angle = std::atan2(dy, dx);
 		if (!shader) shader = defaultShader;
 
-		glm::mat4 transform = glm::mat4(1.0f);
-		transform = glm::rotate(transform, angle, glm::vec3(0.0f, 0.0f, 1.0f));
-
-		auto renderable = std::make_unique<Renderable>(x1, y1 - thickness / 2.0f, curDrawLayer, length, thickness, RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, transform, c);
-
-		if (c.a == 0.0f || c.a == 1.0f) opaque[shader].emplace_back(std::move(renderable));
-		else transparent[shader].emplace_back(std::move(renderable));
+		//rotate around the start point, which sits half the thickness below the quad's top edge
+		Submit(Renderable(x1, y1 - thickness / 2.0f, curDrawLayer, length, thickness, RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, shader, c,
+			angle, Vec2f(0.0f, thickness / 2.0f)), c.a == 0.0f || c.a == 1.0f);
 	}
 
 	void Graphics::DrawRect(const RectF& rect, const Color& c)
 	{
-		glm::mat4 transform(1.0f);
-		auto renderable = std::make_unique<Renderable>(rect.left, rect.top, curDrawLayer, float(rect.GetWidth()), float(rect.GetHeight()),
-			RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, transform, c);
-		if (c.a == 0.0f || c.a == 1.0f) opaque[defaultShader].emplace_back(std::move(renderable));
-		else transparent[defaultShader].emplace_back(std::move(renderable));
+		Submit(Renderable(rect.left, rect.top, curDrawLayer, float(rect.GetWidth()), float(rect.GetHeight()),
+			RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, defaultShader, c), c.a == 0.0f || c.a == 1.0f);
 	}
 
 	void Graphics::DrawRect(Vec2f pos, Vec2f size, const Color& c)
@@ -400,64 +625,208 @@ namespace sl
 
 	void Graphics::DrawRect(const RectF& rect, const Color& c, float angle, Shader* shader)
 	{
-		glm::mat4 transform(1.0f);
 		if (!shader) shader = defaultShader;
-
-		Vec2f center = rect.GetCenter();
-		transform = glm::translate(transform, glm::vec3(center.x, center.y, 0.0f));
-		transform = glm::rotate(transform, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
-		transform = glm::translate(transform, glm::vec3(-center.x, -center.y, 0.0f));
-
-		auto renderable = std::make_unique<Renderable>(rect.left, rect.top, curDrawLayer, float(rect.GetWidth()), float(rect.GetHeight()),
-			RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, transform, c);
-		if (c.a == 0.0f || c.a == 1.0f) opaque[shader].emplace_back(std::move(renderable));
-		else transparent[shader].emplace_back(std::move(renderable));
+		Vec2f halfSize(rect.GetWidth() / 2.0f, rect.GetHeight() / 2.0f);
+		Submit(Renderable(rect.left, rect.top, curDrawLayer, float(rect.GetWidth()), float(rect.GetHeight()),
+			RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, shader, c, glm::radians(angle), halfSize), c.a == 0.0f || c.a == 1.0f);
 	}
 
 	void Graphics::DrawText(float x, float y, const std::string& text, Font* font, float height, const Color& c)
 	{
 		if (!font) font = defaultFont;
-		assert(font->GetTextureAtlas() && "Failed to draw text. Font atlas is nullptr");
 		assert(font && "Failed to draw text. Both font and default font are nullptrs");
+		assert(font->GetTextureAtlas() && "Failed to draw text. Font atlas is nullptr");
 
-		const std::vector<stbtt_bakedchar>& charData = font->GetCharData();
-		Texture* atlas = font->GetTextureAtlas();
-		float baseLineHeight = font->GetLineHeight();
+		const TextRun* run = GetTextRun(text, font, height);
+		if (run->glyphs.empty()) return;
+		Renderable renderable(x + run->bounds.left, y + run->bounds.top, curDrawLayer, run->bounds.GetWidth(), run->bounds.GetHeight(), RectF(0.0f, 1.0f, 0.0f, 1.0f),
+			font->GetTextureAtlas(), defaultShader, c);
+		renderable.textRun = run;
+		Submit(renderable, font->GetTextureAtlas()->IsBinaryAlpha() && (c.a == 1.0f || c.a == 0.0f));
+	}
 
-		float scale = height / baseLineHeight;
+	void Graphics::DrawText(float x, float y, const std::string& text, DynamicFont& font, int pixelSize, const Color& c)
+	{
 		float xCursor = x;
-		float yCursor = y + scale * float(font->GetAscent() / font->GetLineHeight()) - height * scale;
+		float baseline = y + font.GetAscent(pixelSize);
+		float scale = font.GetGlyphScale(pixelSize);
+		Shader* shader = font.IsSignedDistanceField() ? sdfTextShader : defaultShader;
+		unsigned int previous = 0;
+		for (size_t i = 0; i < text.size();)
+		{
+			unsigned int codepoint = DynamicFont::NextCodepoint(text, i);
+			if (previous) xCursor += font.GetKerning(previous, codepoint, pixelSize);
+			previous = codepoint;
+			const DynamicFont::Glyph* glyph = font.GetGlyph(codepoint, pixelSize);
+			if (!glyph) continue;
+			if (glyph->page)
+			{
+				Submit(Renderable(xCursor + glyph->offset.x * scale, baseline + glyph->offset.y * scale, curDrawLayer, glyph->size.x * scale, glyph->size.y * scale,
+					glyph->uv, glyph->page, shader, c), false);
+			}
+			xCursor += glyph->advance * scale;
+		}
+	}
+
+	const Graphics::TextRun* Graphics::GetTextRun(const std::string& text, const Font* font, float height)
+	{
+		TextRunKey key{ font, std::hash<std::string_view>()(text), height };
+		auto [it, inserted] = textRuns.try_emplace(key);
+		TextRun& run = it->second;
+		run.lastUsedFrame = frameIndex;
+		//a hash collision relays the entry out instead of drawing the wrong string
+		if (!inserted && run.text == text)
+		{
+			stats.textRunHits++;
+			return &run;
+		}
+		stats.textRunMisses++;
+		run.text = text;
+		run.glyphs.clear();
 
+		const std::vector<stbtt_bakedchar>& charData = font->GetCharData();
+		const Texture* atlas = font->GetTextureAtlas();
+		float scale = height / float(font->GetLineHeight());
+		//the pen starts on the baseline, the ascent moves the top of the line to the draw position
+		float xCursor = 0.0f;
+		float yCursor = 0.0f;
+		float baseline = float(font->GetAscent()) * scale;
+		RectF bounds(INFINITY, -INFINITY, INFINITY, -INFINITY);
 		for (char ch : text)
 		{
 			if (ch < font->GetFirstChar() || ch >= font->GetLastChar()) continue;
 			stbtt_aligned_quad quad;
 			stbtt_GetBakedQuad(charData.data(), atlas->GetWidth(), atlas->GetHeight(), ch - font->GetFirstChar(), &xCursor, &yCursor, &quad, 1);
-			float quadWidth = (quad.x1 - quad.x0) * scale;
-			float quadHeight = (quad.y1 - quad.y0) * scale;
-			Vec2f drawPos = Vec2f(quad.x0 * scale, quad.y0 * scale);
-			RectF uv(quad.s0 * atlas->GetWidth(), quad.s1 * atlas->GetWidth(), quad.t1 * atlas->GetHeight(), quad.t0 * atlas->GetHeight());
-			DrawTexture(drawPos, Vec2f(quadWidth, quadHeight), atlas, nullptr, false, false, 0.0f, Vec2f(0, 0), &uv, c);
+			Glyph glyph{ Vec2f(quad.x0 * scale, baseline + quad.y0 * scale), Vec2f((quad.x1 - quad.x0) * scale, (quad.y1 - quad.y0) * scale),
+				RectF(quad.s0, quad.s1, quad.t1, quad.t0) };
+			bounds.left = std::min(bounds.left, glyph.pos.x);
+			bounds.top = std::min(bounds.top, glyph.pos.y);
+			bounds.right = std::max(bounds.right, glyph.pos.x + glyph.size.x);
+			bounds.bottom = std::max(bounds.bottom, glyph.pos.y + glyph.size.y);
+			run.glyphs.push_back(glyph);
+		}
+		if (run.glyphs.empty())
+		{
+			run.bounds = RectF(0.0f, 0.0f, 0.0f, 0.0f);
+			return &run;
+		}
+		for (Glyph& glyph : run.glyphs) glyph.pos -= Vec2f(bounds.left, bounds.top);
+		run.bounds = bounds;
+		return &run;
+	}
+
+	void Graphics::ExpireTextRuns()
+	{
+		for (auto it = textRuns.begin(); it != textRuns.end();)
+		{
+			if (frameIndex - it->second.lastUsedFrame > textRunLifetime) it = textRuns.erase(it);
+			else ++it;
+		}
+	}
+
+	void Graphics::DrawTilemap(Tilemap& tilemap, Shader* shader)
+	{
+		if (!shader) shader = defaultShader;
+		const Texture* atlas = tilemap.GetAtlas();
+
+		//only walk the chunks under the view so the cost follows what is on screen, not the map size
+		int firstX = 0, firstY = 0;
+		int lastX = tilemap.chunksX - 1, lastY = tilemap.chunksY - 1;
+		if (cullingEnabled && viewZoom > 0.0f)
+		{
+			const RectF view = GetViewRect();
+			Vec2f chunkSize = tilemap.GetTileSize() * float(tilemap.chunkSize);
+			Vec2f position = tilemap.GetPosition();
+			firstX = std::max(firstX, int(std::floor((view.left - position.x) / chunkSize.x)));
+			firstY = std::max(firstY, int(std::floor((view.top - position.y) / chunkSize.y)));
+			lastX = std::min(lastX, int(std::floor((view.right - position.x) / chunkSize.x)));
+			lastY = std::min(lastY, int(std::floor((view.bottom - position.y) / chunkSize.y)));
+		}
+		for (int y = firstY; y <= lastY; y++)
+		{
+			for (int x = firstX; x <= lastX; x++)
+			{
+				int index = y * tilemap.chunksX + x;
+				if (tilemap.chunks[index].tileCount == 0) continue;
+				RectF rect = tilemap.GetChunkRect(x, y);
+				Renderable renderable(rect.left, rect.top, curDrawLayer, rect.GetWidth(), rect.GetHeight(), RectF(0.0f, 1.0f, 0.0f, 1.0f), atlas, shader, Colors::White);
+				renderable.tilemap = &tilemap;
+				renderable.chunkIndex = index;
+				Submit(renderable, atlas->IsBinaryAlpha());
+			}
+		}
+	}
+
+	void Graphics::DrawSpriteBatch(SpriteBatch& batch, Shader* shader)
+	{
+		if (batch.IsEmpty()) return;
+		if (!shader) shader = defaultShader;
+		const Texture* texture = nullptr;
+		for (const Texture* t : batch.textures)
+		{
+			if (t)
+			{
+				texture = t;
+				break;
+			}
 		}
+		RectF bounds = batch.GetBounds();
+		Renderable renderable(bounds.left, bounds.top, curDrawLayer, bounds.GetWidth(), bounds.GetHeight(), RectF(0.0f, 1.0f, 0.0f, 1.0f), texture, shader, Colors::White);
+		renderable.spriteBatch = &batch;
+		Submit(renderable, batch.IsOpaque());
 	}
 
 	void Graphics::PutPixel(float x, float y, const Color& c)
 	{
-		auto renderable = std::make_unique<Renderable>(x, y, curDrawLayer, 1.0f, 1.0f, RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, glm::mat4(1.0f), c);
-		if (c.a == 1.0f) opaque[defaultShader].emplace_back(std::move(renderable));
-		else transparent[defaultShader].emplace_back(std::move(renderable));
+		Submit(Renderable(x, y, curDrawLayer, 1.0f, 1.0f, RectF(0.0f, 1.0f, 0.0f, 1.0f), blankTexture, defaultShader, c), c.a == 1.0f);
 	}
 
 	Color Graphics::GetPixel(int x, int y)
 	{
-		unsigned char pixelData[4];
-		glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
-		int r = pixelData[0];
-		int g = pixelData[1];
-		int b = pixelData[2];
-		int a = pixelData[3];
-		Color c = Color::FromBytes(a, r, g, b);
-		return c;
+		return ReadPixels(RectI(x, x + 1, y, y + 1)).GetPixel(0, 0);
+	}
+
+	ReadbackTicket Graphics::RequestPixels(const RectI& region)
+	{
+		assert(region.left >= 0 && region.top >= 0 && region.right <= int(canvasWidth) && region.bottom <= int(canvasHeight) && "Failed to request pixels. Region is outside of the canvas");
+		ReadbackTicket ticket = readback.Request(fbo, int(canvasHeight), region.left, region.top, region.GetWidth(), region.GetHeight());
+		stats.readbacksDropped = readback.GetDropped();
+		return ticket;
+	}
+
+	ReadbackTicket Graphics::RequestCanvasPixels()
+	{
+		return RequestPixels(RectI(0, int(canvasWidth), 0, int(canvasHeight)));
+	}
+
+	bool Graphics::CollectPixels(ReadbackTicket ticket, PixelRegion& pixels)
+	{
+		return readback.Collect(ticket, pixels);
+	}
+
+	PixelRegion Graphics::ReadPixels(const RectI& region)
+	{
+		assert(region.left >= 0 && region.top >= 0 && region.right <= int(canvasWidth) && region.bottom <= int(canvasHeight) && "Failed to read pixels. Region is outside of the canvas");
+		PixelRegion pixels;
+		PixelReadback::Read(fbo, int(canvasHeight), region.left, region.top, region.GetWidth(), region.GetHeight(), pixels);
+		return pixels;
+	}
+
+	void Graphics::SetReadbackSlots(int count)
+	{
+		readback.SetSlotCount(count);
+	}
+
+	RectF Graphics::GetViewRect() const
+	{
+		return RectF(viewPosition, canvasWidth / viewZoom, canvasHeight / viewZoom);
+	}
+
+	Vec2f Graphics::ScreenToWorld(const Vec2f& screenPos) const
+	{
+		RectI rect = GetPresentRect();
+		Vec2f canvasPos((screenPos.x - float(rect.left)) * canvasWidth / float(rect.GetWidth()), (screenPos.y - float(rect.top)) * canvasHeight / float(rect.GetHeight()));
+		return viewPosition + canvasPos / viewZoom;
 	}
 
 	RectF Graphics::GetCanvasRect() const
@@ -465,6 +834,21 @@ namespace sl
 		return RectF(0.0f, canvasWidth, 0.0f, canvasHeight);
 	}
 
+	RectI Graphics::GetPresentRect() const
+	{
+		int windowWidth = std::max(window->GetWidth(), 1);
+		int windowHeight = std::max(window->GetHeight(), 1);
+		if (presentScaling == PresentScaling::Stretch) return RectI(0, windowWidth, 0, windowHeight);
+
+		float scale = std::min(float(windowWidth) / canvasWidth, float(windowHeight) / canvasHeight);
+		if (presentScaling == PresentScaling::Integer && scale >= 1.0f) scale = std::floor(scale);
+		int width = std::max(int(canvasWidth * scale), 1);
+		int height = std::max(int(canvasHeight * scale), 1);
+		int left = (windowWidth - width) / 2;
+		int top = (windowHeight - height) / 2;
+		return RectI(left, left + width, top, top + height);
+	}
+
 	float Graphics::GetCanvasWidth() const
 	{
 		return canvasWidth;
@@ -482,44 +866,67 @@ namespace sl
 			canvasWidth = width;
 			canvasHeight = height;
 			vpMat.projection = glm::ortho(0.0f, canvasWidth, canvasHeight, 0.0f, -50.0f, 50.0f);
-			BindUniformBuffer(vpMatUbo);
-			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(vpMat), &vpMat);
-
-			size_t size = size_t(canvasWidth) * size_t(canvasHeight) * 4;
-			unsigned char* buffer = (unsigned char*)malloc(size);
-			assert(buffer);
-			if (buffer)
-			{
-				if (framebufferTexture) UnloadTexture(framebufferTexture);
-				if (framebufferTextureSecondary) UnloadTexture(framebufferTextureSecondary);
-				memset(buffer, 0, size);
-				framebufferTexture = CreateTextureFromMemory(int(canvasWidth), int(canvasHeight), 4, buffer, TextureWrap::ClampToEdge, TextureFilter::Nearest, TextureFilter::Nearest);
-				framebufferTextureSecondary = CreateTextureFromMemory(int(canvasWidth), int(canvasHeight), 4, buffer, TextureWrap::ClampToEdge, TextureFilter::Nearest, TextureFilter::Nearest);
-				free(buffer);
-			}
-			assert(framebufferTexture);
-			BindTexture(framebufferTexture);
-			UseTexture(framebufferTexture);
+			glNamedBufferSubData(vpMatUbo, 0, sizeof(vpMat), &vpMat);
+			CreateCanvas();
+		}
+	}
 
-			if (fbo != 0) glDeleteFramebuffers(1, &fbo);
-			if (rbo != 0) glDeleteRenderbuffers(1, &rbo);
+	void Graphics::SetCanvasFormat(TextureFormat format)
+	{
+		if (format == canvasFormat) return;
+		canvasFormat = format;
+		CreateCanvas();
+	}
 
-			glGenFramebuffers(1, &fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	void Graphics::SetCanvasDepth(bool enabled)
+	{
+		if (enabled == canvasDepth) return;
+		//queued keys were built for the old mode and Render would read their blend bit from the wrong place
+		assert(renderQueue.IsEmpty() && "Failed to set canvas depth. Draws are still queued");
+		canvasDepth = enabled;
+		CreateCanvas();
+	}
 
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferTexture->GetHandle(), 0);
-			glGenRenderbuffers(1, &rbo);
-			glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, int(canvasWidth), int(canvasHeight));
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+	void Graphics::CreateCanvas()
+	{
+		if (framebufferTexture) UnloadTexture(framebufferTexture);
+		if (framebufferTextureSecondary) UnloadTexture(framebufferTextureSecondary);
+		//the canvas is cleared every BeginFrame, so the targets are allocated without any cpu data
+		framebufferTexture = CreateRenderTexture(int(canvasWidth), int(canvasHeight), canvasFormat);
+		framebufferTextureSecondary = CreateRenderTexture(int(canvasWidth), int(canvasHeight), canvasFormat);
+		BindTexture(framebufferTexture);
+		UseTexture(framebufferTexture);
+
+		if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+		if (rbo != 0) glDeleteRenderbuffers(1, &rbo);
+		rbo = 0;
+
+		glCreateFramebuffers(1, &fbo);
+		glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, framebufferTexture->GetHandle(), 0);
+		if (canvasDepth)
+		{
+			glCreateRenderbuffers(1, &rbo);
+			glNamedRenderbufferStorage(rbo, GL_DEPTH24_STENCIL8, int(canvasWidth), int(canvasHeight));
+			glNamedFramebufferRenderbuffer(fbo, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			{
-				throw std::runtime_error("Frame buffer is not complete");
-			}
+		if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			throw std::runtime_error("Frame buffer is not complete");
 		}
 	}
 
+	Texture* Graphics::CreateRenderTexture(int width, int height, TextureFormat format)
+	{
+		std::string name = "__dynamic_" + std::to_string(totalDynamiclyCreatedTextures++);
+		std::unique_ptr<Texture> texture = std::make_unique<Texture>(width, height, format);
+		Texture* rawPtr = texture.get();
+		textureToSlot[rawPtr] = -1;
+		textures[name] = std::move(texture);
+		return rawPtr;
+	}
+
 	void Graphics::BindVertexArray(unsigned int vao)
 	{
 		if (boundVAO != vao)
@@ -576,148 +983,469 @@ namespace sl
 
 	void Graphics::ClearBatchData()
 	{
-		vertices.clear();
-		indices.clear();
-		opaque.clear();
-		transparent.clear();
+		renderQueue.Clear();
+		frameTransforms.clear();
 		usedTextures.clear();
 		instanceDataBuffer.clear();
 	}
 
-	void Graphics::Render()
+	void Graphics::Submit(Renderable renderable, bool isOpaque)
 	{
-		if (!opaque.empty())
+		//the variant is part of the shader handle in the sort key, so quads sharing one are batched together
+		if (renderable.shader == builtInShader && !renderable.tilemap && !renderable.spriteBatch)
 		{
-			for (auto& [shader, renderables] : opaque)
-			{
-				currentShader = shader;
-				for (auto& renderable : renderables)
-				{
-					UploadRenderable(renderable.get());
-				}
-				FlushBatch();
-			}
+			unsigned int defines = 0;
+			if (renderable.texture == blankTexture) defines |= Shader::SolidColor;
+			if (isOpaque && renderable.color.a == 1.0f && renderable.texture->IsOpaque()) defines |= Shader::NoDiscard;
+			if (defines) renderable.shader = GetShaderVariant(builtInShader, defines);
 		}
+		if (renderQueue.Push(MakeSortKey(renderable, isOpaque), renderable)) stats.commandBufferGrowths++;
+		stats.submitted++;
+	}
 
-		if (!transparent.empty())
+	bool Graphics::IsVisible(const Renderable& renderable, const RectF& view)
+	{
+		//arbitrary transforms are not bounded by the rect, never cull them
+		if (renderable.transformIndex != -1) return true;
+		float halfWidth = std::abs(renderable.width) / 2.0f;
+		float halfHeight = std::abs(renderable.height) / 2.0f;
+		Vec2f center(renderable.x + renderable.width / 2.0f, renderable.y + renderable.height / 2.0f);
+		if (renderable.angle != 0.0f)
 		{
-			std::vector<std::pair<Shader*, Renderable*>> sortedTransparent;
-			for (auto& [shader, renderables] : transparent)
-			{
-				assert(shader);
-				for (auto& renderable : renderables)
-				{
-					sortedTransparent.emplace_back(shader, renderable.get());
-				}
-			}
+			float s = std::sin(renderable.angle);
+			float c = std::cos(renderable.angle);
+			Vec2f pivot(renderable.x + renderable.origin.x, renderable.y + renderable.origin.y);
+			Vec2f local = center - pivot;
+			center = pivot + Vec2f(c * local.x - s * local.y, s * local.x + c * local.y);
+			float rotatedHalfWidth = std::abs(c) * halfWidth + std::abs(s) * halfHeight;
+			float rotatedHalfHeight = std::abs(s) * halfWidth + std::abs(c) * halfHeight;
+			halfWidth = rotatedHalfWidth;
+			halfHeight = rotatedHalfHeight;
+		}
+		return center.x + halfWidth >= view.left && center.x - halfWidth <= view.right &&
+			center.y + halfHeight >= view.top && center.y - halfHeight <= view.bottom;
+	}
 
-			std::sort(sortedTransparent.begin(), sortedTransparent.end(),
-				[&](const auto& a, const auto& b)
-				{
-					return a.second->z < b.second->z;
-				});
+	uint64_t Graphics::MakeSortKey(const Renderable& renderable, bool isOpaque) const
+	{
+		//order preserving bit pattern of the layer, higher layers are closer to the camera
+		uint32_t depth = 0;
+		memcpy(&depth, &renderable.z, sizeof(depth));
+		depth = (depth & 0x80000000u) ? ~depth : (depth | 0x80000000u);
+		//draws on one layer overlap in submission order, the sequence is unique so no state field would sort below it
+		uint64_t sequence = renderQueue.GetSize() & 0x7FFFFFFFFFull;
+		if (!canvasDepth)
+		{
+			//depth 24 | sequence 39 | blend 1, one back to front order for everything
+			return (uint64_t(depth >> 8) << 40) | (sequence << 1) | (isOpaque ? 0 : 1);
+		}
+		if (isOpaque)
+		{
+			//blend 0 | shader 15 | texture 24 | depth 24, front to back inside each state group
+			uint64_t shaderId = renderable.shader->GetHandle() & 0x7FFFu;
+			uint64_t textureId = renderable.texture->GetHandle() & 0xFFFFFFu;
+			return (shaderId << 48) | (textureId << 24) | (uint64_t(~depth) >> 8);
+		}
+		//blend 1 | depth 24 | sequence 39, back to front
+		return (uint64_t(1) << 63) | (uint64_t(depth >> 8) << 39) | sequence;
+	}
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDepthMask(GL_FALSE);
+	void Graphics::Render()
+	{
+		for (auto& textureArray : textureArrays) textureArray->UpdateMipmaps();
+		for (auto& textureAtlas : textureAtlases) textureAtlas->UpdateMipmaps();
+		if (cullingEnabled && viewZoom > 0.0f)
+		{
+			const RectF view = GetViewRect();
+			size_t culled = renderQueue.KeepIf([&](const Renderable& renderable) { return IsVisible(renderable, view); });
+			stats.culled += culled;
+		}
+		if (renderQueue.IsEmpty())
+		{
+			ClearBatchData();
+			return;
+		}
+		stats.drawn += renderQueue.GetSize();
 
-			for (auto& [shader, renderable] : sortedTransparent)
+		size_t unsortedBreaks = 0;
+		size_t unsortedTextureChanges = 0;
+		for (size_t i = 1; i < renderQueue.GetSize(); i++)
+		{
+			const Renderable& prev = renderQueue[i - 1];
+			const Renderable& cur = renderQueue[i];
+			if (prev.shader != cur.shader) unsortedBreaks++;
+			if (prev.texture != cur.texture) unsortedTextureChanges++;
+		}
+		renderQueue.Sort();
+
+		size_t sortedBreaks = 0;
+		size_t sortedTextureChanges = 0;
+		bool blending = false;
+		currentShader = renderQueue[0].shader;
+		const Texture* lastTexture = renderQueue[0].texture;
+		for (size_t i = 0; i < renderQueue.GetSize(); i++)
+		{
+			Renderable& renderable = renderQueue[i];
+			uint64_t key = renderQueue.GetKey(i);
+			bool transparent = canvasDepth ? (key >> 63) != 0 : (key & 1) != 0;
+			if (transparent && !blending)
+			{
+				FlushBatch();
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glDepthMask(GL_FALSE);
+				blending = true;
+			}
+			else if (!transparent && blending)
+			{
+				//only without a depth buffer, where opaque and blended draws interleave
+				FlushBatch();
+				glDepthMask(GL_TRUE);
+				glDisable(GL_BLEND);
+				blending = false;
+			}
+			if (renderable.shader != currentShader)
+			{
+				assert(renderable.shader);
+				FlushBatch();
+				currentShader = renderable.shader;
+				sortedBreaks++;
+			}
+			if (renderable.texture != lastTexture)
+			{
+				lastTexture = renderable.texture;
+				sortedTextureChanges++;
+			}
+			if (renderable.textRun)
 			{
-				if (shader != currentShader)
+				//the run is one queue entry, its glyphs are only expanded here
+				for (const Glyph& glyph : renderable.textRun->glyphs)
 				{
-					assert(shader);
-					FlushBatch();
-					currentShader = shader;
+					Renderable glyphRenderable(renderable.x + glyph.pos.x, renderable.y + glyph.pos.y, renderable.z, glyph.size.x, glyph.size.y, glyph.uv,
+						renderable.texture, renderable.shader, renderable.color);
+					UploadRenderable(&glyphRenderable);
 				}
-				UploadRenderable(renderable);
+				continue;
 			}
-			FlushBatch();
+			if (renderable.tilemap || renderable.spriteBatch)
+			{
+				FlushBatch();
+				if (renderable.tilemap) DrawTilemapChunk(renderable);
+				else DrawSpriteBatchInstances(renderable);
+				continue;
+			}
+			UploadRenderable(&renderable);
+		}
+		FlushBatch();
 
+		if (blending)
+		{
 			glDepthMask(GL_TRUE);
 			glDisable(GL_BLEND);
 		}
+		if (unsortedBreaks > sortedBreaks) stats.flushesSaved += unsortedBreaks - sortedBreaks;
+		if (unsortedTextureChanges > sortedTextureChanges) stats.textureChangesSaved += unsortedTextureChanges - sortedTextureChanges;
 
 		ClearBatchData();
 	}
 
 	void Graphics::FlushBatch()
 	{
-		BindShaderStorageBuffer(instanceSSBO);
+		if (instanceDataBuffer.empty()) return;
+		stats.flushes++;
+		stats.drawCalls++;
+		Shader* shader = currentShader;
+		//untinted batches skip the multiply, picked here so tint never splits a batch
+		if (!batchTinted && shader->IsVariantOf(builtInShader) && !(shader->GetDefines() & Shader::SolidColor))
+		{
+			shader = GetShaderVariant(builtInShader, shader->GetDefines() | Shader::Untinted);
+		}
+		batchTinted = false;
+		BindShader(shader->GetHandle());
+		shader->UpdateUniformBuffers();
+		boundUBO = 0;
 		BindVertexArray(vao);
-		BindVertexBuffer(vbo);
-		BindIndexBuffer(ibo);
-		BindShader(currentShader->GetHandle());
 
-		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(InstanceData) * int(instanceDataBuffer.size()), instanceDataBuffer.data());
-		glBufferSubData(GL_ARRAY_BUFFER, 0, int(vertices.size() * sizeof(TextureVertex)), vertices.data());
-		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(unsigned int) * int(indices.size()), indices.data());
-
-		glDrawElements(GL_TRIANGLES, int(indices.size()), GL_UNSIGNED_INT, nullptr);
-		vertices.clear();
-		indices.clear();
+		size_t instanceBytes = sizeof(InstanceData) * instanceDataBuffer.size();
+		size_t transformBytes = sizeof(glm::mat4) * transformBuffer.size();
+		if (streamBuffer)
+		{
+			//one reservation per flush, two could straddle a region switch that fences the instances before the draw reading them
+			size_t alignment = size_t(ssboOffsetAlignment);
+			size_t transformStart = (instanceBytes + alignment - 1) / alignment * alignment;
+			size_t offset = 0;
+			unsigned char* mapped = (unsigned char*)streamBuffer->Reserve(transformStart + transformBytes, alignment, offset);
+			memcpy(mapped, instanceDataBuffer.data(), instanceBytes);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, instanceSSBOBindingPoint, streamBuffer->GetHandle(), GLintptr(offset), GLsizeiptr(instanceBytes));
+			if (!transformBuffer.empty())
+			{
+				memcpy(mapped + transformStart, transformBuffer.data(), transformBytes);
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, transformSSBOBindingPoint, streamBuffer->GetHandle(), GLintptr(offset + transformStart), GLsizeiptr(transformBytes));
+			}
+			stats.streamStalls = streamBuffer->GetStalls();
+			boundSSBO = streamBuffer->GetHandle();
+		}
+		else
+		{
+			BindShaderStorageBuffer(instanceSSBO);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(instanceBytes), instanceDataBuffer.data());
+			if (!transformBuffer.empty())
+			{
+				BindShaderStorageBuffer(transformSSBO);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(transformBytes), transformBuffer.data());
+			}
+		}
+		glDrawElements(GL_TRIANGLES, int(6 * instanceDataBuffer.size()), GL_UNSIGNED_INT, nullptr);
 		usedTextures.clear();
+		usedTextureArraySlots = 0;
 		instanceDataBuffer.clear();
+		transformBuffer.clear();
 	}
 
-	void Graphics::UploadRenderable(Renderable* renderable)
+	void Graphics::DrawTilemapChunk(const Renderable& renderable)
 	{
-		if (vertices.size() == maxQuadsInBatch * 4)
+		Tilemap& tilemap = *renderable.tilemap;
+		Tilemap::Chunk& chunk = tilemap.chunks[renderable.chunkIndex];
+		const Texture* atlas = tilemap.GetAtlas();
+		//chunks sample through the reserved slots, so the baked slot never changes with lru traffic
+		const Texture* page = atlas->GetAtlasPage() ? atlas->GetAtlasPage() : atlas;
+		int slot = retainedTextureSlot;
+		if (const TextureArray* array = page->GetArray())
 		{
-			FlushBatch();
+			slot = 0x8000 | ((textureArraySlotCount - 1) << 11) | page->GetArrayLayer();
+			glBindTextureUnit(maxTextureSlots + textureArraySlotCount - 1, array->GetHandle());
 		}
+		else glBindTextureUnit(retainedTextureSlot, page->GetHandle());
 
-		const Texture* texture = renderable->texture;
+		if (chunk.dirty || chunk.textureSlot != slot || chunk.layer != renderable.z)
+		{
+			int chunkX = renderable.chunkIndex % tilemap.chunksX;
+			int chunkY = renderable.chunkIndex / tilemap.chunksX;
+			int firstX = chunkX * tilemap.chunkSize;
+			int firstY = chunkY * tilemap.chunkSize;
+			int lastX = std::min(firstX + tilemap.chunkSize, tilemap.width);
+			int lastY = std::min(firstY + tilemap.chunkSize, tilemap.height);
+			Vec2f tileSize = tilemap.GetTileSize();
+			Vec2f position = tilemap.GetPosition();
+
+			retainedInstanceBuffer.clear();
+			for (int y = firstY; y < lastY; y++)
+			{
+				for (int x = firstX; x < lastX; x++)
+				{
+					int tile = tilemap.tiles[size_t(y) * tilemap.width + x];
+					if (tile < 0) continue;
+					Renderable tileRenderable(position.x + x * tileSize.x, position.y + y * tileSize.y, renderable.z, tileSize.x, tileSize.y,
+						tilemap.GetTileUV(tile), atlas, renderable.shader, Colors::White);
+					retainedInstanceBuffer.emplace_back(tileRenderable, slot, -1);
+				}
+			}
+			tilemap.UploadChunk(chunk, retainedInstanceBuffer.data(), sizeof(InstanceData), unsigned int(retainedInstanceBuffer.size()));
+			chunk.textureSlot = slot;
+			chunk.layer = renderable.z;
+			stats.tilemapChunkRebuilds++;
+		}
+		if (chunk.instanceCount == 0) return;
+		DrawRetainedInstances(chunk.buffer, chunk.instanceCount);
+		stats.tilemapChunks++;
+	}
 
-		int slot = GetTextureSlot(texture);
-		if (usedTextures.size() == maxTextureSlots && slot == -1)
+	void Graphics::DrawSpriteBatchInstances(const Renderable& renderable)
+	{
+		SpriteBatch& batch = *renderable.spriteBatch;
+		assert(batch.textures.size() <= size_t(retainedTextureSlot) && "Failed to draw sprite batch. Too many distinct textures");
+		if (batch.layer != renderable.z)
 		{
-			FlushBatch();
+			batch.layer = renderable.z;
+			batch.MarkAllDirty();
+		}
+		for (size_t i = 0; i < batch.textures.size(); i++)
+		{
+			if (!batch.textures[i]) continue;
+			int slot = GetRetainedTextureSlot(batch.textures[i]);
+			if (batch.textureSlots[i] != slot)
+			{
+				batch.textureSlots[i] = slot;
+				batch.MarkTextureDirty(static_cast<unsigned short>(i));
+			}
+		}
+		batch.Reserve(sizeof(InstanceData), batch.GetSize());
+
+		//coalesce the dirty records into contiguous runs, each run is one sub-data upload
+		std::vector<unsigned int>& dirty = batch.dirtyIndices;
+		std::sort(dirty.begin(), dirty.end());
+		const unsigned int count = unsigned int(batch.GetSize());
+		size_t i = 0;
+		while (i < dirty.size() && dirty[i] < count)
+		{
+			unsigned int first = dirty[i];
+			unsigned int last = first;
+			while (i + 1 < dirty.size() && dirty[i + 1] <= last + 1 && dirty[i + 1] < count) last = dirty[++i];
+			i++;
 
-			BindTexture(texture);
-			slot = GetTextureSlot(texture);
+			retainedInstanceBuffer.clear();
+			for (unsigned int j = first; j <= last; j++)
+			{
+				const Vec2f& pos = batch.positions[j];
+				const Vec2f& size = batch.sizes[j];
+				Renderable sprite(pos.x, pos.y, batch.layer, size.x, size.y, batch.uvs[j], batch.textures[batch.textureIndices[j]], renderable.shader,
+					batch.colors[j], batch.angles[j], batch.origins[j]);
+				retainedInstanceBuffer.emplace_back(sprite, batch.textureSlots[batch.textureIndices[j]], -1);
+				batch.dirtyFlags[j] = false;
+			}
+			glNamedBufferSubData(batch.buffer, GLintptr(sizeof(InstanceData) * first), GLsizeiptr(sizeof(InstanceData) * retainedInstanceBuffer.size()), retainedInstanceBuffer.data());
+			stats.spriteBatchUploads += retainedInstanceBuffer.size();
 		}
-		else if (slot == -1)
+		dirty.clear();
+
+		DrawRetainedInstances(batch.buffer, count);
+		stats.spriteBatches++;
+	}
+
+	int Graphics::GetRetainedTextureSlot(const Texture* texture)
+	{
+		if (const Texture* page = texture->GetAtlasPage()) texture = page;
+		if (const TextureArray* array = texture->GetArray())
+		{
+			return 0x8000 | (GetTextureArraySlot(array) << 11) | texture->GetArrayLayer();
+		}
+		//the batch was just flushed, so evicting a slot here cannot break pending instances
+		int slot = GetTextureSlot(texture);
+		if (slot == -1)
 		{
 			BindTexture(texture);
 			slot = GetTextureSlot(texture);
 		}
-		assert(slot != -1);
-		float width = renderable->width;
-		float height = renderable->height;
-		int instanceIdx = int(instanceDataBuffer.size());
+		UseTexture(texture);
+		return slot;
+	}
 
-		unsigned int vertStart = unsigned int(vertices.size());
+	void Graphics::DrawRetainedInstances(unsigned int buffer, size_t count)
+	{
+		BindShader(currentShader->GetHandle());
+		currentShader->UpdateUniformBuffers();
+		boundUBO = 0;
+		BindVertexArray(vao);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceSSBOBindingPoint, buffer);
+		//the static index buffer covers maxQuadsInBatch quads, larger buffers are walked through the base vertex
+		for (size_t first = 0; first < count; first += maxQuadsInBatch)
+		{
+			size_t quads = std::min(maxQuadsInBatch, count - first);
+			glDrawElementsBaseVertex(GL_TRIANGLES, int(6 * quads), GL_UNSIGNED_INT, nullptr, int(4 * first));
+			stats.drawCalls++;
+		}
+		//the plain upload path writes through the indexed binding, point it back at the shared buffer
+		if (streamBuffer) boundSSBO = buffer;
+		else
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceSSBOBindingPoint, instanceSSBO);
+			boundSSBO = instanceSSBO;
+		}
+	}
 
-		RectF uv = renderable->uv;
+	void Graphics::UploadRenderable(Renderable* renderable)
+	{
+		if (instanceDataBuffer.size() == maxQuadsInBatch)
+		{
+			FlushBatch();
+		}
 
-		float x = renderable->x;
-		float y = renderable->y;
-		float z = renderable->z;
-		vertices.emplace_back(TextureVertex(x, y, z, uv.left, uv.bottom, instanceIdx)); // bottom-left
-		vertices.emplace_back(TextureVertex(x + width, y, z, uv.right, uv.bottom, instanceIdx)); // bottom-right
-		vertices.emplace_back(TextureVertex(x + width, y + height, z, uv.right, uv.top, instanceIdx)); // top-right
-		vertices.emplace_back(TextureVertex(x, y + height, z, uv.left, uv.top, instanceIdx)); // top-left
+		const Texture* texture = renderable->texture;
+		//atlas sub-textures bind their page, the uv is remapped when the instance is built
+		if (const Texture* page = texture->GetAtlasPage()) texture = page;
 
-		indices.emplace_back(vertStart);
-		indices.emplace_back(vertStart + 1);
-		indices.emplace_back(vertStart + 2);
+		int slot = -1;
+		if (const TextureArray* array = texture->GetArray())
+		{
+			//array flag | array slot 4 bits | layer 11 bits
+			slot = 0x8000 | (GetTextureArraySlot(array) << 11) | texture->GetArrayLayer();
+		}
+		else
+		{
+			slot = GetTextureSlot(texture);
+			if (usedTextures.size() == size_t(retainedTextureSlot) && slot == -1)
+			{
+				FlushBatch();
 
-		indices.emplace_back(vertStart);
-		indices.emplace_back(vertStart + 2);
-		indices.emplace_back(vertStart + 3);
+				BindTexture(texture);
+				slot = GetTextureSlot(texture);
+			}
+			else if (slot == -1)
+			{
+				BindTexture(texture);
+				slot = GetTextureSlot(texture);
+			}
+			assert(slot != -1);
 
-		UseTexture(texture);
-		renderable->data.textureSlot = float(slot);
+			UseTexture(texture);
+			if (std::find(usedTextures.begin(), usedTextures.end(), texture) == usedTextures.end()) usedTextures.push_back(texture);
+		}
+		int transformIndex = -1;
+		if (renderable->transformIndex != -1)
+		{
+			transformIndex = int(transformBuffer.size());
+			transformBuffer.push_back(frameTransforms[renderable->transformIndex]);
+		}
+		instanceDataBuffer.emplace_back(*renderable, slot, transformIndex);
+		if (instanceDataBuffer.back().color != 0xFFFFFFFFu) batchTinted = true;
+	}
 
-		instanceDataBuffer.push_back(renderable->data);
-		if (!usedTextures.contains(texture)) usedTextures.insert(texture);
+	int Graphics::GetTextureArraySlot(const TextureArray* array)
+	{
+		int freeSlot = -1;
+		for (int i = 0; i < textureArraySlotCount - 1; i++)
+		{
+			if (textureArraySlots[i] == array)
+			{
+				usedTextureArraySlots |= 1u << i;
+				return i;
+			}
+			if (freeSlot == -1 && !(usedTextureArraySlots & (1u << i))) freeSlot = i;
+		}
+		if (freeSlot == -1)
+		{
+			FlushBatch();
+			freeSlot = nextTextureArraySlot;
+			nextTextureArraySlot = (nextTextureArraySlot + 1) % (textureArraySlotCount - 1);
+		}
+		glBindTextureUnit(maxTextureSlots + freeSlot, array->GetHandle());
+		textureArraySlots[freeSlot] = array;
+		usedTextureArraySlots |= 1u << freeSlot;
+		return freeSlot;
 	}
 
 	Texture* Graphics::LoadTexture(const std::string& filepath, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
 	{
 		if (!textures.contains(filepath))
 		{
-			std::unique_ptr<Texture> texture = std::make_unique<Texture>(filepath, wrap, minFilter, magFilter);
+			std::unique_ptr<Texture> texture;
+			//packed images have no source file to stamp a cache entry with
+			if (textureCache && !(assetPack && assetPack->Contains(filepath)))
+			{
+				bool withMips = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+					minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+				TextureCache::Image image;
+				if (!textureCache->Load(filepath, withMips, image))
+				{
+					int width, height, BPP;
+					unsigned char* buffer = DecodeImage(filepath, width, height, BPP);
+					assert(buffer);
+					if (!textureCache->Save(filepath, width, height, BPP, buffer, withMips, &image))
+					{
+						texture = std::make_unique<Texture>(width, height, BPP, buffer, wrap, minFilter, magFilter);
+					}
+					stbi_image_free(buffer);
+				}
+				if (!texture) texture = std::make_unique<Texture>(image.width, image.height, image.levels, image.binaryAlpha, image.opaque, wrap, minFilter, magFilter);
+			}
+			else
+			{
+				int width, height, BPP;
+				unsigned char* buffer = DecodeImage(filepath, width, height, BPP);
+				assert(buffer);
+				texture = std::make_unique<Texture>(width, height, BPP, buffer, wrap, minFilter, magFilter);
+				stbi_image_free(buffer);
+			}
 			Texture* rawPtr = texture.get();
 			textureToSlot[rawPtr] = -1;
 			textures[filepath] = std::move(texture);
@@ -725,6 +1453,225 @@ namespace sl
 		return textures[filepath].get();
 	}
 
+	Texture* Graphics::LoadArrayTexture(const std::string& filepath, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
+	{
+		std::string name = "__array_" + filepath;
+		if (!textures.contains(name))
+		{
+			int width = 0;
+			int height = 0;
+			int BPP = 0;
+			unsigned char* buffer = DecodeImage(filepath, width, height, BPP);
+			assert(buffer);
+			assert(BPP >= 1 && BPP <= 4 && "Failed to load array texture. Unsupported channel count");
+			//grey with alpha has no matching upload format, the page is shared so a per texture swizzle is not an option either
+			std::vector<unsigned char> expanded;
+			if (BPP == 2)
+			{
+				expanded.resize(size_t(width) * height * 4);
+				for (size_t i = 0; i < size_t(width) * height; i++)
+				{
+					expanded[i * 4] = expanded[i * 4 + 1] = expanded[i * 4 + 2] = buffer[i * 2];
+					expanded[i * 4 + 3] = buffer[i * 2 + 1];
+				}
+			}
+
+			TextureArray* page = nullptr;
+			for (auto& textureArray : textureArrays)
+			{
+				if (!textureArray->IsFull() && textureArray->IsCompatible(width, height, wrap, minFilter, magFilter))
+				{
+					page = textureArray.get();
+					break;
+				}
+			}
+			if (!page)
+			{
+				//pages are sized from a byte budget, the whole layer range is allocated at creation
+				bool withMips = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+					minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+				size_t layerBytes = size_t(width) * height * 4;
+				if (withMips) layerBytes = layerBytes * 4 / 3;
+				int layers = int(std::clamp<size_t>(textureArrayPageBudget / std::max<size_t>(layerBytes, 1), 1, size_t(textureArrayPageLayers)));
+				textureArrays.emplace_back(std::make_unique<TextureArray>(width, height, layers, wrap, minFilter, magFilter));
+				page = textureArrays.back().get();
+			}
+			if (expanded.empty()) textures[name] = std::make_unique<Texture>(page, page->AllocateLayer(), BPP, buffer);
+			else textures[name] = std::make_unique<Texture>(page, page->AllocateLayer(), 4, expanded.data());
+			stbi_image_free(buffer);
+		}
+		return textures[name].get();
+	}
+
+	Texture* Graphics::LoadTextureAsync(const std::string& filepath, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter, std::function<void(Texture*)> onLoaded)
+	{
+		if (textures.contains(filepath))
+		{
+			Texture* texture = textures[filepath].get();
+			if (onLoaded)
+			{
+				auto it = std::find_if(asyncLoads.begin(), asyncLoads.end(), [texture](const auto& load) { return load.second.texture == texture; });
+				if (it != asyncLoads.end()) it->second.callbacks.push_back(std::move(onLoaded));
+				else onLoaded(texture);
+			}
+			return texture;
+		}
+		if (!textureLoader)
+		{
+			int threads = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, 4);
+			textureLoader = std::make_unique<TextureLoader>(threads);
+			//the loader is dropped on cache switches, the pbo outlives it
+			if (!uploadPBO) glCreateBuffers(1, &uploadPBO);
+		}
+
+		//the header is enough to report the final size, sprites built on the placeholder get the right dimensions
+		int width = 1, height = 1, channels = 0;
+		AssetPack::Asset asset;
+		bool packed = assetPack && assetPack->Read(filepath, asset);
+		if (packed) stbi_info_from_memory(asset.GetData(), int(asset.GetSize()), &width, &height, &channels);
+		else stbi_info(filepath.c_str(), &width, &height, &channels);
+		std::unique_ptr<Texture> texture = std::make_unique<Texture>(width, height, wrap, minFilter, magFilter);
+		Texture* rawPtr = texture.get();
+		textureToSlot[rawPtr] = -1;
+		textures[filepath] = std::move(texture);
+
+		unsigned long long id = nextAsyncLoadId++;
+		AsyncLoad& load = asyncLoads[id];
+		load.texture = rawPtr;
+		if (onLoaded) load.callbacks.push_back(std::move(onLoaded));
+		bool withMips = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+		textureLoader->Enqueue(id, filepath, true, packed ? nullptr : textureCache.get(), withMips, packed ? assetPack : nullptr);
+		return rawPtr;
+	}
+
+	void Graphics::SetTextureCache(const std::string& directory)
+	{
+		assert(asyncLoads.empty() && "Failed to set texture cache. Async loads are still pending");
+		//loader jobs hold the cache pointer, stop the workers before it goes away
+		textureLoader.reset();
+		if (directory.empty()) textureCache.reset();
+		else textureCache = std::make_unique<TextureCache>(directory);
+	}
+
+	void Graphics::SetAssetPack(const AssetPack* pack)
+	{
+		assert(asyncLoads.empty() && "Failed to set asset pack. Async loads are still pending");
+		assetPack = pack;
+	}
+
+	unsigned char* Graphics::DecodeImage(const std::string& filepath, int& width, int& height, int& BPP) const
+	{
+		stbi_set_flip_vertically_on_load(1);
+		AssetPack::Asset asset;
+		if (assetPack && assetPack->Read(filepath, asset))
+		{
+			return stbi_load_from_memory(asset.GetData(), int(asset.GetSize()), &width, &height, &BPP, 0);
+		}
+		return stbi_load(filepath.c_str(), &width, &height, &BPP, 0);
+	}
+
+	void Graphics::SetShaderCache(const std::string& directory)
+	{
+		if (directory.empty()) shaderCache.reset();
+		else shaderCache = std::make_unique<ShaderCache>(directory);
+	}
+
+	void Graphics::SetTextureArrayPageBudget(size_t bytes)
+	{
+		textureArrayPageBudget = bytes;
+	}
+
+	void Graphics::SetTextureUploadBudget(size_t bytes)
+	{
+		textureUploadBudget = bytes;
+	}
+
+	void Graphics::ProcessTextureUploads()
+	{
+		if (!textureLoader) return;
+		size_t uploaded = 0;
+		TextureLoader::Result result;
+		while (true)
+		{
+			size_t size = textureLoader->PeekResultSize();
+			if (uploaded > 0 && uploaded + size > textureUploadBudget) break;
+			if (!textureLoader->PopResult(result)) break;
+
+			//unloaded before the decode finished
+			auto it = asyncLoads.find(result.id);
+			if (it == asyncLoads.end()) continue;
+			AsyncLoad load = std::move(it->second);
+			asyncLoads.erase(it);
+
+			if (result.IsValid())
+			{
+				//orphan and refill the staging buffer, the driver copies into the texture without stalling this thread
+				size_t bytes = result.GetSize();
+				glNamedBufferData(uploadPBO, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW);
+				void* staging = glMapNamedBufferRange(uploadPBO, 0, GLsizeiptr(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				memcpy(staging, result.GetPixels(), bytes);
+				glUnmapNamedBuffer(uploadPBO);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+				if (result.cached.levels.size() > 1)
+				{
+					std::vector<const unsigned char*> offsets;
+					for (const unsigned char* level : result.cached.levels) offsets.push_back(reinterpret_cast<const unsigned char*>(size_t(level - result.cached.levels[0])));
+					load.texture->Store(result.width, result.height, offsets, result.binaryAlpha, result.opaque);
+				}
+				else load.texture->Store(result.width, result.height, result.BPP, nullptr, result.binaryAlpha, result.opaque);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				//the store swapped in a new handle, a slot still holding the placeholder's would sample a deleted texture
+				int slot = GetTextureSlot(load.texture);
+				if (slot != -1) glBindTextureUnit(slot, load.texture->GetHandle());
+				uploaded += bytes;
+			}
+			for (auto& callback : load.callbacks) callback(load.texture);
+		}
+	}
+
+	Texture* Graphics::LoadTexture(const std::string& filepath, TextureAtlas* atlas)
+	{
+		assert(atlas && "Failed to load texture. Atlas is nullptr");
+		if (Texture* existing = atlas->Find(filepath)) return existing;
+		int width, height, BPP;
+		unsigned char* buffer = DecodeImage(filepath, width, height, BPP);
+		assert(buffer);
+		Texture* texture = atlas->Add(filepath, width, height, BPP, buffer);
+		stbi_image_free(buffer);
+		//images larger than a page fall back to their own texture
+		if (!texture) texture = LoadTexture(filepath);
+		return texture;
+	}
+
+	TextureAtlas* Graphics::CreateTextureAtlas(int pageSize, int padding, TextureFilter minFilter, TextureFilter magFilter)
+	{
+		textureAtlases.push_back(std::make_unique<TextureAtlas>(pageSize, padding, minFilter, magFilter));
+		return textureAtlases.back().get();
+	}
+
+	void Graphics::RepackTextureAtlas(TextureAtlas* atlas)
+	{
+		assert(atlas && "Failed to repack atlas. Atlas is nullptr");
+		//queued renderables only hold sub-texture pointers, which follow their image to the new page
+		std::vector<std::unique_ptr<Texture>> retired = atlas->Repack();
+		for (const std::unique_ptr<Texture>& page : retired) ReleaseTextureSlot(page.get());
+	}
+
+	void Graphics::UnloadTextureAtlas(TextureAtlas* atlas)
+	{
+		assert(atlas && "Failed to unload atlas. Atlas is nullptr");
+		for (size_t i = 0; i < atlas->GetPageCount(); i++) ReleaseTextureSlot(atlas->GetPage(i));
+		for (auto it = textureAtlases.begin(); it != textureAtlases.end(); ++it)
+		{
+			if (it->get() == atlas)
+			{
+				textureAtlases.erase(it);
+				break;
+			}
+		}
+	}
+
 	Texture* Graphics::CreateTextureFromMemory(int width, int height, int BPP, unsigned char* buffer, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
 	{
 		std::string name = "__dynamic_" + std::to_string(totalDynamiclyCreatedTextures++);
@@ -743,19 +1690,12 @@ namespace sl
 			int charCount = lastChar - firstChar + 1;
 			std::vector<stbtt_bakedchar> charData(charCount);
 			charData.resize(charCount, {});
-			FILE* file = nullptr;
-			errno_t err = fopen_s(&file, filepath.c_str(), "rb");
-			assert(err == 0 && file);
-
-			fseek(file, 0, SEEK_END);
-			size_t size = ftell(file);
-			fseek(file, 0, SEEK_SET);
-
-			std::vector<unsigned char> ttfBuffer(size);
-			fread(ttfBuffer.data(), size, 1, file);
-			fclose(file);
+			//the font is only needed while baking, a raw packed entry is read straight from the mapping
+			AssetPack::Asset ttf;
+			bool loaded = AssetPack::Load(assetPack, filepath, ttf);
+			assert(loaded && "Failed to load font. File not found");
 			stbtt_fontinfo info;
-			stbtt_InitFont(&info, ttfBuffer.data(), 0);
+			stbtt_InitFont(&info, ttf.GetData(), 0);
 
 			int ascent, descent, lineGap;
 			stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
@@ -766,7 +1706,7 @@ namespace sl
 			const int texWidth = 512;
 			const int texHeight = 512;
 			std::vector<unsigned char> bitmap(texWidth * texHeight, 0);
-			stbtt_BakeFontBitmap(ttfBuffer.data(), 0, fontLineHeight, bitmap.data(), texWidth, texHeight, firstChar, charCount, charData.data());
+			stbtt_BakeFontBitmap(ttf.GetData(), 0, fontLineHeight, bitmap.data(), texWidth, texHeight, firstChar, charCount, charData.data());
 			std::vector<unsigned char> buffer(texWidth * texHeight * 4);
 			for (size_t i = 0; i < size_t(texWidth * texHeight); i++)
 			{
@@ -777,7 +1717,7 @@ namespace sl
 				buffer[i * 4 + 3] = a;
 			}
 			Texture* atlas = CreateTextureFromMemory(texWidth, texHeight, 4, buffer.data(), TextureWrap::ClampToEdge, TextureFilter::LinearMipmapLinear, TextureFilter::Linear);
-			fonts[filepath] = std::make_unique<Font>(atlas, std::move(charData), realLineHeight, ascent, firstChar, lastChar);
+			fonts[filepath] = std::make_unique<Font>(atlas, std::move(charData), realLineHeight, int(ascent * scale), firstChar, lastChar);
 		}
 		return fonts[filepath].get();
 	}
@@ -785,16 +1725,20 @@ namespace sl
 	void Graphics::UnloadTexture(Texture* texture)
 	{
 		assert(texture && "Failed to unload texture. Texture is nullptr");
-		lru.Erase(texture);
-		auto texSlotIt = textureToSlot.find(texture);
-
-		int slot = texSlotIt->second;
-		if (slot != -1)
+		if (TextureAtlas* atlas = texture->GetAtlas())
 		{
-			slotToTexture.erase(slot);
-			availableSlots.insert(slot);
+			atlas->Remove(texture);
+			return;
 		}
-		textureToSlot.erase(texSlotIt);
+		if (!texture->IsReady())
+		{
+			std::erase_if(asyncLoads, [texture](const auto& load) { return load.second.texture == texture; });
+		}
+		if (TextureArray* array = texture->GetArray())
+		{
+			array->FreeLayer(texture->GetArrayLayer());
+		}
+		else ReleaseTextureSlot(texture);
 
 		for (auto it = textures.begin(); it != textures.end(); ++it)
 		{
@@ -806,10 +1750,40 @@ namespace sl
 		}
 	}
 
+	DynamicFont* Graphics::LoadDynamicFont(const std::string& filepath, int pageSize, int maxPages, bool signedDistanceField)
+	{
+		std::string name = signedDistanceField ? filepath + "|sdf" : filepath;
+		if (!dynamicFonts.contains(name))
+		{
+			//glyphs are rasterized for the font's whole lifetime, so it keeps its own copy
+			AssetPack::Asset ttf;
+			bool loaded = AssetPack::Load(assetPack, filepath, ttf);
+			assert(loaded && "Failed to load dynamic font. File not found");
+			std::vector<unsigned char> ttfBuffer(ttf.GetData(), ttf.GetData() + ttf.GetSize());
+			dynamicFonts[name] = std::make_unique<DynamicFont>(std::move(ttfBuffer), pageSize, maxPages, signedDistanceField);
+		}
+		return dynamicFonts[name].get();
+	}
+
+	void Graphics::UnloadDynamicFont(DynamicFont* font)
+	{
+		assert(font && "Failed to unload dynamic font. Font is nullptr");
+		for (size_t i = 0; i < font->GetPageCount(); i++) ReleaseTextureSlot(font->GetPage(i));
+		for (auto it = dynamicFonts.begin(); it != dynamicFonts.end(); ++it)
+		{
+			if (it->second.get() == font)
+			{
+				dynamicFonts.erase(it);
+				break;
+			}
+		}
+	}
+
 	void Graphics::UnloadFont(Font* font)
 	{
 		assert(font && "Failed to unload font. Font is nullptr");
 		UnloadTexture(font->GetTextureAtlas());
+		std::erase_if(textRuns, [font](const auto& entry) { return entry.first.font == font; });
 		for (auto it = fonts.begin(); it != fonts.end(); ++it)
 		{
 			if (it->second.get() == font)
@@ -825,18 +1799,63 @@ namespace sl
 		std::string name = vertex + '|' + fragment;
 		if (!shaders.contains(name))
 		{
-			std::unique_ptr<Shader> shader = std::make_unique<Shader>(vertex, fragment, isPath);
-			int slots[32]{};
-			for (int i = 0; i < 32; i++) slots[i] = i;
-			BindShader(shader->GetHandle());
-			shader->SetUniform1iv("uTextures", 32, slots);
-			
-			Shader* rawPtr = shader.get();
+			std::unique_ptr<Shader> shader;
+			if (isPath)
+			{
+				AssetPack::Asset vertexSource, fragmentSource;
+				bool loaded = AssetPack::Load(assetPack, vertex, vertexSource) && AssetPack::Load(assetPack, fragment, fragmentSource);
+				assert(loaded && "Failed to load shader. File not found");
+				shader = std::make_unique<Shader>(std::string(reinterpret_cast<const char*>(vertexSource.GetData()), vertexSource.GetSize()),
+					std::string(reinterpret_cast<const char*>(fragmentSource.GetData()), fragmentSource.GetSize()), false, shaderCache.get());
+			}
+			else shader = std::make_unique<Shader>(vertex, fragment, false, shaderCache.get());
+			SetTextureUniforms(shader.get());
+			shaders[name] = std::move(shader);
+		}
+		return shaders[name].get();
+	}
+
+	Shader* Graphics::LoadPostProcessShader(const std::string& fragment, bool isPath)
+	{
+		std::string name = "__post_" + fragment;
+		if (!shaders.contains(name))
+		{
+			std::string fragmentSource = fragment;
+			if (isPath)
+			{
+				AssetPack::Asset asset;
+				bool loaded = AssetPack::Load(assetPack, fragment, asset);
+				assert(loaded && "Failed to load post process shader. File not found");
+				fragmentSource.assign(reinterpret_cast<const char*>(asset.GetData()), asset.GetSize());
+			}
+			std::unique_ptr<Shader> shader = std::make_unique<Shader>(postProcessVertexShader, fragmentSource, false, shaderCache.get());
+			int sourceUnit = maxTextureSlots + textureArraySlotCount;
+			if (shader->HasUniform("uSource")) shader->SetUniform1i("uSource", sourceUnit);
+			if (shader->HasUniform("uScene")) shader->SetUniform1i("uScene", sourceUnit + 1);
 			shaders[name] = std::move(shader);
 		}
 		return shaders[name].get();
 	}
 
+	Shader* Graphics::GetShaderVariant(Shader* shader, unsigned int defines)
+	{
+		assert(shader && "Failed to get shader variant. Shader is nullptr");
+		bool created = !shader->HasVariant(defines);
+		//the cache is passed per call, shaders keep no pointer to it so SetShaderCache can replace it at any time
+		Shader* variant = shader->GetVariant(defines, shaderCache.get());
+		if (created) SetTextureUniforms(variant);
+		return variant;
+	}
+
+	void Graphics::SetTextureUniforms(Shader* shader)
+	{
+		std::vector<int> slots(maxTextureSlots + textureArraySlotCount);
+		for (int i = 0; i < int(slots.size()); i++) slots[i] = i;
+		//variants that never sample, like SOLID_COLOR, have the samplers optimized out
+		if (shader->HasUniform("uTextures")) shader->SetUniform1iv("uTextures", maxTextureSlots, slots.data());
+		if (shader->HasUniform("uTextureArrays")) shader->SetUniform1iv("uTextureArrays", textureArraySlotCount, slots.data() + maxTextureSlots);
+	}
+
 	void Graphics::UnloadShader(Shader* shader)
 	{
 		assert(shader && "Failed to unload shader. Shader is nullptr");
@@ -852,7 +1871,24 @@ namespace sl
 
 	int Graphics::GetTextureSlot(const Texture* texture)
 	{
-		return textureToSlot[texture];
+		//textures owned outside the texture map (glyph pages) are registered on first bind
+		auto it = textureToSlot.find(texture);
+		return it == textureToSlot.end() ? -1 : it->second;
+	}
+
+	void Graphics::ReleaseTextureSlot(const Texture* texture)
+	{
+		lru.Erase(texture);
+		auto texSlotIt = textureToSlot.find(texture);
+		if (texSlotIt == textureToSlot.end()) return;
+
+		int slot = texSlotIt->second;
+		if (slot != -1)
+		{
+			slotToTexture.erase(slot);
+			availableSlots.insert(slot);
+		}
+		textureToSlot.erase(texSlotIt);
 	}
 
 	void Graphics::BindTexture(const Texture* texture)
@@ -892,6 +1928,6 @@ namespace sl
 		slotToTexture.clear();
 		textures.clear();
 		availableSlots.clear();
-		for (int i = 0; i < maxTextureSlots; i++) availableSlots.insert(i);
+		for (int i = 0; i < retainedTextureSlot; i++) availableSlots.insert(i);
 	}
 }
\ No newline at end of file
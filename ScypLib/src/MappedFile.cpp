@@ -0,0 +1,105 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#endif
+#include<utility>
+
+#include"ScypLib/MappedFile.h"
+
+namespace sl
+{
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+#ifdef _WIN32
+			std::swap(file, other.file);
+			std::swap(mapping, other.mapping);
+#else
+			std::swap(descriptor, other.descriptor);
+#endif
+			std::swap(data, other.data);
+			std::swap(size, other.size);
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			file = nullptr;
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			Close();
+			return false;
+		}
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		size = size_t(fileSize.QuadPart);
+#else
+		descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor == -1) return false;
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+		{
+			Close();
+			return false;
+		}
+		void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+		data = view == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(view);
+		size = size_t(info.st_size);
+#endif
+		if (!data)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file) CloseHandle(file);
+		file = nullptr;
+		mapping = nullptr;
+#else
+		if (data) munmap(const_cast<unsigned char*>(data), size);
+		if (descriptor != -1) close(descriptor);
+		descriptor = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+}
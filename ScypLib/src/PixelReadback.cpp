@@ -0,0 +1,173 @@
+#include<cassert>
+#include<cstring>
+
+#include"ScypLib/PixelReadback.h"
+
+namespace sl
+{
+	Color PixelRegion::GetPixel(int x, int y) const
+	{
+		assert(x >= 0 && y >= 0 && x < width && y < height && "Failed to get pixel. Position is outside of the region");
+		const unsigned char* pixel = pixels.data() + (size_t(y) * width + x) * 4;
+		return Color::FromBytes(pixel[0], pixel[1], pixel[2], pixel[3]);
+	}
+
+	PixelReadback::PixelReadback(int slotCount)
+	{
+		SetSlotCount(slotCount);
+	}
+
+	PixelReadback::~PixelReadback()
+	{
+		for (Slot& slot : slots) Destroy(slot);
+	}
+
+	ReadbackTicket PixelReadback::Request(unsigned int framebuffer, int framebufferHeight, int x, int y, int width, int height)
+	{
+		assert(width > 0 && height > 0 && "Failed to request readback. Region is empty");
+		Slot& slot = slots[next];
+		next = (next + 1) % slots.size();
+		if (slot.fence)
+		{
+			dropped++;
+			Release(slot);
+		}
+
+		//immutable storage, only recreated when a larger region comes through this slot
+		size_t size = size_t(width) * height * 4;
+		if (slot.capacity < size)
+		{
+			if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+			glCreateBuffers(1, &slot.buffer);
+			glNamedBufferStorage(slot.buffer, GLsizeiptr(size), nullptr, GL_MAP_READ_BIT);
+			slot.capacity = size;
+		}
+
+		int previous = 0;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(x, framebufferHeight - y - height, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, unsigned int(previous));
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.ticket = ++lastTicket;
+		slot.x = x;
+		slot.y = y;
+		slot.width = width;
+		slot.height = height;
+		return slot.ticket;
+	}
+
+	bool PixelReadback::IsReady(ReadbackTicket ticket) const
+	{
+		const Slot* slot = Find(ticket);
+		if (!slot) return false;
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv(slot->fence, GL_SYNC_STATUS, 1, nullptr, &status);
+		return status == GL_SIGNALED;
+	}
+
+	bool PixelReadback::Collect(ReadbackTicket ticket, PixelRegion& region)
+	{
+		if (!IsReady(ticket)) return false;
+		Slot& slot = *Find(ticket);
+		region.x = slot.x;
+		region.y = slot.y;
+		region.width = slot.width;
+		region.height = slot.height;
+		size_t rowSize = size_t(slot.width) * 4;
+		region.pixels.resize(rowSize * slot.height);
+
+		//gl rows start at the bottom, flipped while copying out of the mapping
+		const unsigned char* mapped = (const unsigned char*)glMapNamedBufferRange(slot.buffer, 0, GLsizeiptr(rowSize * slot.height), GL_MAP_READ_BIT);
+		assert(mapped && "Failed to map readback buffer. Mapping is nullptr");
+		for (int row = 0; row < slot.height; row++)
+		{
+			memcpy(region.pixels.data() + rowSize * row, mapped + rowSize * (slot.height - 1 - row), rowSize);
+		}
+		glUnmapNamedBuffer(slot.buffer);
+		Release(slot);
+		return true;
+	}
+
+	bool PixelReadback::Wait(ReadbackTicket ticket, PixelRegion& region)
+	{
+		const Slot* slot = Find(ticket);
+		if (!slot) return false;
+		GLenum result = GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		return Collect(ticket, region);
+	}
+
+	void PixelReadback::Read(unsigned int framebuffer, int framebufferHeight, int x, int y, int width, int height, PixelRegion& region)
+	{
+		assert(width > 0 && height > 0 && "Failed to read pixels. Region is empty");
+		region.x = x;
+		region.y = y;
+		region.width = width;
+		region.height = height;
+		size_t rowSize = size_t(width) * 4;
+		std::vector<unsigned char> flipped(rowSize * height);
+
+		int previous = 0;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(x, framebufferHeight - y - height, width, height, GL_RGBA, GL_UNSIGNED_BYTE, flipped.data());
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, unsigned int(previous));
+
+		region.pixels.resize(rowSize * height);
+		for (int row = 0; row < height; row++)
+		{
+			memcpy(region.pixels.data() + rowSize * row, flipped.data() + rowSize * (height - 1 - row), rowSize);
+		}
+	}
+
+	void PixelReadback::SetSlotCount(int count)
+	{
+		assert(count > 0 && "Failed to set readback slots. Count must be positive");
+		for (Slot& slot : slots) Destroy(slot);
+		slots.assign(size_t(count), Slot{});
+		next = 0;
+	}
+
+	PixelReadback::Slot* PixelReadback::Find(ReadbackTicket ticket)
+	{
+		for (Slot& slot : slots)
+		{
+			if (ticket && slot.ticket == ticket) return &slot;
+		}
+		return nullptr;
+	}
+
+	const PixelReadback::Slot* PixelReadback::Find(ReadbackTicket ticket) const
+	{
+		for (const Slot& slot : slots)
+		{
+			if (ticket && slot.ticket == ticket) return &slot;
+		}
+		return nullptr;
+	}
+
+	void PixelReadback::Release(Slot& slot)
+	{
+		if (slot.fence) glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		slot.ticket = 0;
+	}
+
+	void PixelReadback::Destroy(Slot& slot)
+	{
+		Release(slot);
+		if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+		slot.capacity = 0;
+	}
+}
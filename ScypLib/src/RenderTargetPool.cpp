@@ -0,0 +1,75 @@
+#include<cassert>
+#include<algorithm>
+
+#include<GL/glew.h>
+
+#include"ScypLib/RenderTargetPool.h"
+
+namespace sl
+{
+	RenderTargetPool::~RenderTargetPool()
+	{
+		for (std::unique_ptr<Target>& target : targets) Destroy(*target);
+	}
+
+	const RenderTargetPool::Target* RenderTargetPool::Acquire(int width, int height, TextureFormat format, size_t frame)
+	{
+		for (std::unique_ptr<Target>& target : targets)
+		{
+			if (!target->inUse && target->width == width && target->height == height && target->format == format)
+			{
+				target->inUse = true;
+				target->lastUsedFrame = frame;
+				return target.get();
+			}
+		}
+
+		std::unique_ptr<Target> target = std::make_unique<Target>();
+		target->width = width;
+		target->height = height;
+		target->format = format;
+		target->lastUsedFrame = frame;
+		target->inUse = true;
+		//immutable storage, no cpu data is ever uploaded into a target
+		glCreateTextures(GL_TEXTURE_2D, 1, &target->texture);
+		glTextureStorage2D(target->texture, 1, GLenum(format), width, height);
+		glTextureParameteri(target->texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(target->texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glCreateFramebuffers(1, &target->framebuffer);
+		glNamedFramebufferTexture(target->framebuffer, GL_COLOR_ATTACHMENT0, target->texture, 0);
+		assert(glCheckNamedFramebufferStatus(target->framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+		targets.push_back(std::move(target));
+		return targets.back().get();
+	}
+
+	void RenderTargetPool::Release(const Target* target)
+	{
+		assert(target && "Failed to release render target. Target is nullptr");
+		for (std::unique_ptr<Target>& pooled : targets)
+		{
+			if (pooled.get() == target)
+			{
+				pooled->inUse = false;
+				return;
+			}
+		}
+	}
+
+	void RenderTargetPool::Trim(size_t frame, size_t maxIdleFrames)
+	{
+		std::erase_if(targets, [frame, maxIdleFrames](std::unique_ptr<Target>& target)
+			{
+				if (target->inUse || frame - target->lastUsedFrame <= maxIdleFrames) return false;
+				Destroy(*target);
+				return true;
+			});
+	}
+
+	void RenderTargetPool::Destroy(Target& target)
+	{
+		glDeleteFramebuffers(1, &target.framebuffer);
+		glDeleteTextures(1, &target.texture);
+		target.framebuffer = 0;
+		target.texture = 0;
+	}
+}
@@ -1,4 +1,6 @@
 #include<cassert>
+#include<cstring>
+#include<algorithm>
 #include<fstream>
 #include<sstream>
 #include<unordered_map>
@@ -10,18 +12,36 @@
 
 namespace sl
 {
-    Shader::Shader(const std::string& vertex, const std::string& fragment, bool isPath)
+    namespace
+    {
+        bool IsFloatType(unsigned int type)
+        {
+            return type == GL_FLOAT || type == GL_FLOAT_VEC2 || type == GL_FLOAT_VEC3 || type == GL_FLOAT_VEC4 ||
+                type == GL_FLOAT_MAT2 || type == GL_FLOAT_MAT3 || type == GL_FLOAT_MAT4;
+        }
+    }
+
+    Shader::Shader(const std::string& vertex, const std::string& fragment, bool isPath, ShaderCache* cache)
     {
         if(isPath)
         {
-            std::string vertexShader = LoadShader(vertex);
-            std::string fragmentShader = LoadShader(fragment);
-            handle = CreateShader(vertexShader, fragmentShader);
+            vertexSource = LoadShader(vertex);
+            fragmentSource = LoadShader(fragment);
         }
         else
         {
-            handle = CreateShader(vertex, fragment);
+            vertexSource = vertex;
+            fragmentSource = fragment;
         }
+        handle = CreateShader(vertexSource, fragmentSource, cache);
+        Reflect();
+    }
+
+    Shader::Shader(Shader* base, unsigned int defines, ShaderCache* cache)
+        : base(base), defines(defines)
+    {
+        handle = CreateShader(AddDefines(base->vertexSource, defines), AddDefines(base->fragmentSource, defines), cache);
+        Reflect();
     }
 
     Shader& Shader::operator=(Shader&& other) noexcept
@@ -32,9 +52,20 @@ namespace sl
             {
                 glDeleteProgram(handle);
             }
+            for (UniformBuffer& uniformBuffer : uniformBuffers) glDeleteBuffers(1, &uniformBuffer.buffer);
 
             handle = other.handle;
-            uniformLocationCache = std::move(other.uniformLocationCache);
+            uniforms = std::move(other.uniforms);
+            uniformBuffers = std::move(other.uniformBuffers);
+            other.uniformBuffers.clear();
+            vertexSource = std::move(other.vertexSource);
+            fragmentSource = std::move(other.fragmentSource);
+            base = other.base;
+            defines = other.defines;
+            variants = std::move(other.variants);
+            other.variants.clear();
+            //variants build from and report against their base, which now lives here
+            for (auto& [variantDefines, variant] : variants) variant->base = this;
             other.handle = 0;
         }
         return *this;
@@ -42,9 +73,42 @@ namespace sl
 
     Shader::~Shader()
     {
+        for (UniformBuffer& uniformBuffer : uniformBuffers) glDeleteBuffers(1, &uniformBuffer.buffer);
         glDeleteProgram(handle);
     }
 
+    Shader* Shader::GetVariant(unsigned int defines, ShaderCache* cache)
+    {
+        if (base) return base->GetVariant(defines, cache);
+        if (defines == 0) return this;
+        std::unique_ptr<Shader>& variant = variants[defines];
+        if (!variant) variant.reset(new Shader(this, defines, cache));
+        return variant.get();
+    }
+
+    bool Shader::HasVariant(unsigned int defines) const
+    {
+        if (base) return base->HasVariant(defines);
+        return defines == 0 || variants.contains(defines);
+    }
+
+    std::string Shader::AddDefines(const std::string& source, unsigned int defines)
+    {
+        static const char* names[] = { "NO_DISCARD", "UNTINTED", "SOLID_COLOR" };
+        std::string lines;
+        for (unsigned int i = 0; i < std::size(names); i++)
+        {
+            if (defines & (1u << i)) lines += std::string("#define ") + names[i] + '\n';
+        }
+        //#version has to stay the first statement
+        size_t version = source.find("#version");
+        size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+        if (insert == std::string::npos) return source + '\n' + lines;
+        std::string result = source;
+        result.insert(version == std::string::npos ? 0 : insert + 1, lines);
+        return result;
+    }
+
     std::string Shader::LoadShader(const std::string& filepath)
     {
         std::ifstream file(filepath);
@@ -116,9 +180,14 @@ namespace sl
         return id;
     }
 
-    unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader)
+    unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader, ShaderCache* cache)
     {
+        if (cache)
+        {
+            if (unsigned int cached = cache->Load(vertexShader, fragmentShader)) return cached;
+        }
         unsigned int program = glCreateProgram();
+        if (cache) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
         unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
 
@@ -131,46 +200,217 @@ namespace sl
         glDeleteShader(vs);
         glDeleteShader(fs);
 
+        if (cache) cache->Save(program, vertexShader, fragmentShader);
         return program;
     }
 
-    int Shader::GetUniformLocation(const std::string& name) const
+    void Shader::Reflect()
+    {
+        uniforms.clear();
+        int count = 0;
+        glGetProgramInterfaceiv(handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        const GLenum properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET, GL_ARRAY_STRIDE };
+        for (int i = 0; i < count; i++)
+        {
+            int values[std::size(properties)];
+            glGetProgramResourceiv(handle, GL_UNIFORM, i, int(std::size(properties)), properties, int(std::size(values)), nullptr, values);
+            Uniform uniform;
+            uniform.name.resize(size_t(values[0]));
+            glGetProgramResourceName(handle, GL_UNIFORM, i, values[0], nullptr, uniform.name.data());
+            uniform.name.resize(strlen(uniform.name.c_str()));
+            //arrays are reported by their first element
+            if (uniform.name.ends_with("[0]")) uniform.name.resize(uniform.name.size() - 3);
+            uniform.handle.type = unsigned int(values[1]);
+            uniform.handle.count = values[2];
+            uniform.handle.location = values[3];
+            uniform.block = values[4];
+            uniform.handle.offset = values[5];
+            uniform.handle.arrayStride = values[6];
+            uniforms.push_back(std::move(uniform));
+        }
+        std::sort(uniforms.begin(), uniforms.end(), [](const Uniform& a, const Uniform& b) { return a.name < b.name; });
+    }
+
+    const Shader::Uniform* Shader::FindUniform(std::string_view name) const
+    {
+        auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const Uniform& uniform, std::string_view key) { return uniform.name < key; });
+        return it != uniforms.end() && it->name == name ? &*it : nullptr;
+    }
+
+    UniformHandle Shader::GetUniform(std::string_view name) const
+    {
+        const Uniform* uniform = FindUniform(name);
+        if (!uniform) return UniformHandle();
+        if (uniform->block == -1) return uniform->handle;
+        for (size_t i = 0; i < uniformBuffers.size(); i++)
+        {
+            if (uniformBuffers[i].block == uniform->block)
+            {
+                UniformHandle handle = uniform->handle;
+                handle.buffer = int(i);
+                return handle;
+            }
+        }
+        return UniformHandle();
+    }
+
+    bool Shader::HasUniform(std::string_view name) const
     {
-        if (uniformLocationCache.contains(name)) return uniformLocationCache[name];
+        return GetUniform(name).IsValid();
+    }
 
-        int location = glGetUniformLocation(handle, name.c_str());
-        assert(location != -1 && ("uniform" + name + "does not exist").c_str());
-        uniformLocationCache[name] = location;
-        return location;
+    bool Shader::EnableUniformBuffer(std::string_view blockName)
+    {
+        std::string name(blockName);
+        unsigned int block = glGetProgramResourceIndex(handle, GL_UNIFORM_BLOCK, name.c_str());
+        if (block == GL_INVALID_INDEX) return false;
+        for (const UniformBuffer& uniformBuffer : uniformBuffers)
+        {
+            if (uniformBuffer.block == int(block)) return true;
+        }
+
+        const GLenum properties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+        int values[2];
+        glGetProgramResourceiv(handle, GL_UNIFORM_BLOCK, block, 2, properties, 2, nullptr, values);
+        //a block without layout(binding = N) sits on 0, which is the renderer's camera buffer, move it to the lowest free binding
+        if (values[0] == 0)
+        {
+            int blockCount = 0;
+            glGetProgramInterfaceiv(handle, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCount);
+            std::vector<int> used(blockCount, 0);
+            const GLenum bindingProperty = GL_BUFFER_BINDING;
+            for (int i = 0; i < blockCount; i++) glGetProgramResourceiv(handle, GL_UNIFORM_BLOCK, unsigned int(i), 1, &bindingProperty, 1, nullptr, &used[i]);
+            int binding = 1;
+            while (std::find(used.begin(), used.end(), binding) != used.end()) binding++;
+            glUniformBlockBinding(handle, block, unsigned int(binding));
+            values[0] = binding;
+        }
+        UniformBuffer uniformBuffer;
+        uniformBuffer.name = std::move(name);
+        uniformBuffer.block = int(block);
+        uniformBuffer.binding = values[0];
+        uniformBuffer.data.resize(size_t(values[1]), 0);
+        glCreateBuffers(1, &uniformBuffer.buffer);
+        glNamedBufferStorage(uniformBuffer.buffer, GLsizeiptr(uniformBuffer.data.size()), uniformBuffer.data.data(), GL_DYNAMIC_STORAGE_BIT);
+        uniformBuffers.push_back(std::move(uniformBuffer));
+        return true;
+    }
+
+    void Shader::UpdateUniformBuffers()
+    {
+        for (UniformBuffer& uniformBuffer : uniformBuffers)
+        {
+            if (uniformBuffer.dirty)
+            {
+                glNamedBufferSubData(uniformBuffer.buffer, 0, GLsizeiptr(uniformBuffer.data.size()), uniformBuffer.data.data());
+                uniformBuffer.dirty = false;
+            }
+            glBindBufferBase(GL_UNIFORM_BUFFER, unsigned int(uniformBuffer.binding), uniformBuffer.buffer);
+        }
+    }
+
+    void Shader::WriteUniformBuffer(const UniformHandle& uniform, const void* value, size_t size, int count)
+    {
+        assert(uniform.buffer >= 0 && uniform.buffer < int(uniformBuffers.size()));
+        UniformBuffer& uniformBuffer = uniformBuffers[uniform.buffer];
+        //std140 pads array elements to their stride
+        size_t stride = count > 1 ? size_t(uniform.arrayStride) : size;
+        assert(uniform.offset + stride * (count - 1) + size <= uniformBuffer.data.size());
+        for (int i = 0; i < count; i++)
+        {
+            memcpy(uniformBuffer.data.data() + uniform.offset + stride * i, static_cast<const unsigned char*>(value) + size * i, size);
+        }
+        uniformBuffer.dirty = true;
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, float v)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT && "Failed to set uniform. Handle is not a float");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v, sizeof(v));
+        else glProgramUniform1f(handle, uniform.location, v);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const glm::vec2& v)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT_VEC2 && "Failed to set uniform. Handle is not a vec2");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v, sizeof(v));
+        else glProgramUniform2f(handle, uniform.location, v.x, v.y);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const glm::vec3& v)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT_VEC3 && "Failed to set uniform. Handle is not a vec3");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v, sizeof(v));
+        else glProgramUniform3f(handle, uniform.location, v.x, v.y, v.z);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const glm::vec4& v)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT_VEC4 && "Failed to set uniform. Handle is not a vec4");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v, sizeof(v));
+        else glProgramUniform4f(handle, uniform.location, v.x, v.y, v.z, v.w);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, int v)
+    {
+        //ints also set bools and samplers
+        assert(uniform.IsValid() && !IsFloatType(uniform.type) && "Failed to set uniform. Handle is not an int");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v, sizeof(v));
+        else glProgramUniform1i(handle, uniform.location, v);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const glm::mat4& v)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT_MAT4 && "Failed to set uniform. Handle is not a mat4");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, &v[0][0], sizeof(v));
+        else glProgramUniformMatrix4fv(handle, uniform.location, 1, GL_FALSE, &v[0][0]);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const float* values, int count)
+    {
+        assert(uniform.IsValid() && uniform.type == GL_FLOAT && count <= uniform.count && "Failed to set uniform. Handle is not a float array of that size");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, values, sizeof(float), count);
+        else glProgramUniform1fv(handle, uniform.location, count, values);
+    }
+
+    void Shader::SetUniform(UniformHandle uniform, const int* values, int count)
+    {
+        assert(uniform.IsValid() && !IsFloatType(uniform.type) && count <= uniform.count && "Failed to set uniform. Handle is not an int array of that size");
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, values, sizeof(int), count);
+        else glProgramUniform1iv(handle, uniform.location, count, values);
     }
 
-    void Shader::SetUniform4i(const std::string& name, int v0, int v1, int v2, int v3)
+    void Shader::SetUniform4i(std::string_view name, int v0, int v1, int v2, int v3)
     {
-        glUniform4i(GetUniformLocation(name), v0, v1, v2, v3);
+        UniformHandle uniform = GetUniform(name);
+        assert(uniform.IsValid() && uniform.type == GL_INT_VEC4 && "Failed to set uniform. Uniform is not an active ivec4");
+        int values[4] = { v0, v1, v2, v3 };
+        if (uniform.buffer != -1) WriteUniformBuffer(uniform, values, sizeof(values));
+        else glProgramUniform4i(handle, uniform.location, v0, v1, v2, v3);
     }
 
-    void Shader::SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3)
+    void Shader::SetUniform4f(std::string_view name, float v0, float v1, float v2, float v3)
     {
-        glUniform4f(GetUniformLocation(name), v0, v1, v2, v3);
+        SetUniform(GetUniform(name), glm::vec4(v0, v1, v2, v3));
     }
 
-    void Shader::SetUniform1f(const std::string& name, float v)
+    void Shader::SetUniform1f(std::string_view name, float v)
     {
-        glUniform1f(GetUniformLocation(name), v);
+        SetUniform(GetUniform(name), v);
     }
 
-    void Shader::SetUniform1i(const std::string& name, int v)
+    void Shader::SetUniform1i(std::string_view name, int v)
     {
-        glUniform1i(GetUniformLocation(name), v);
+        SetUniform(GetUniform(name), v);
     }
 
-    void Shader::SetUniform1iv(const std::string& name, int count, int* data)
+    void Shader::SetUniform1iv(std::string_view name, int count, int* data)
     {
-        glUniform1iv(GetUniformLocation(name), count, data);
+        SetUniform(GetUniform(name), data, count);
     }
 
-    void Shader::SetUniformMat4f(const std::string& name, const glm::mat4& matrix)
+    void Shader::SetUniformMat4f(std::string_view name, const glm::mat4& matrix)
     {
-        glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]);
+        SetUniform(GetUniform(name), matrix);
     }
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<vector>
+#include<filesystem>
+#include<functional>
+
+#include<GL/glew.h>
+
+#include"ScypLib/MappedFile.h"
+#include"ScypLib/ShaderCache.h"
+
+namespace sl
+{
+	namespace
+	{
+		constexpr uint32_t cacheMagic = 0x42504C53;//"SLPB"
+		constexpr uint32_t cacheVersion = 2;
+
+		struct CacheHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint32_t driverLength;
+			uint32_t vertexLength;
+			uint32_t fragmentLength;
+			uint32_t binaryFormat;
+			uint32_t binaryLength;//the driver string, both sources and the binary follow the header
+		};
+	}
+
+	ShaderCache::ShaderCache(const std::string& directory)
+		: directory(directory)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		supported = formats > 0;
+		//a driver update or a different gpu makes every old binary invalid, so the strings are part of the key
+		const char* strings[] = {
+			reinterpret_cast<const char*>(glGetString(GL_VENDOR)),
+			reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+			reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+			reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)) };
+		for (const char* string : strings)
+		{
+			if (string) driver += string;
+			driver += '|';
+		}
+	}
+
+	unsigned int ShaderCache::Load(const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		if (!supported)
+		{
+			misses++;
+			return 0;
+		}
+		unsigned long long key = GetKey(vertexSource, fragmentSource);
+		MappedFile file;
+		if (!file.Open(GetEntryPath(key)))
+		{
+			misses++;
+			return 0;
+		}
+
+		const unsigned char* data = file.GetData();
+		CacheHeader header;
+		bool valid = file.GetSize() >= sizeof(header);
+		if (valid)
+		{
+			memcpy(&header, data, sizeof(header));
+			valid = header.magic == cacheMagic && header.version == cacheVersion && header.key == key &&
+				header.driverLength == driver.size() && header.vertexLength == vertexSource.size() && header.fragmentLength == fragmentSource.size() &&
+				header.binaryLength > 0 && file.GetSize() - sizeof(header) >= size_t(header.driverLength) + header.vertexLength + header.fragmentLength + header.binaryLength;
+		}
+		//the key is only a 64 bit hash, a colliding entry would link fine and draw the wrong program
+		const unsigned char* stored = data + sizeof(header);
+		if (valid)
+		{
+			valid = memcmp(stored, driver.data(), driver.size()) == 0 &&
+				memcmp(stored + driver.size(), vertexSource.data(), vertexSource.size()) == 0 &&
+				memcmp(stored + driver.size() + vertexSource.size(), fragmentSource.data(), fragmentSource.size()) == 0;
+		}
+		unsigned int program = 0;
+		if (valid)
+		{
+			program = glCreateProgram();
+			glProgramBinary(program, header.binaryFormat, stored + driver.size() + vertexSource.size() + fragmentSource.size(), GLsizei(header.binaryLength));
+			int linked = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			if (linked == GL_FALSE)
+			{
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
+		if (!program)
+		{
+			rejected++;
+			misses++;
+			return 0;
+		}
+		hits++;
+		return program;
+	}
+
+	bool ShaderCache::Save(unsigned int program, const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		int linked = GL_FALSE;
+		int length = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!supported || linked == GL_FALSE || length <= 0) return false;
+
+		std::vector<unsigned char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		CacheHeader header{};
+		header.magic = cacheMagic;
+		header.version = cacheVersion;
+		header.key = GetKey(vertexSource, fragmentSource);
+		header.driverLength = uint32_t(driver.size());
+		header.vertexLength = uint32_t(vertexSource.size());
+		header.fragmentLength = uint32_t(fragmentSource.size());
+		header.binaryFormat = format;
+		header.binaryLength = uint32_t(length);
+
+		//written next to the entry and renamed so a crash never leaves a half written binary
+		std::string entryPath = GetEntryPath(header.key);
+		std::string tempPath = entryPath + ".tmp";
+		FILE* file = nullptr;
+		errno_t err = fopen_s(&file, tempPath.c_str(), "wb");
+		if (err != 0 || !file) return false;
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(driver.data(), 1, driver.size(), file) == driver.size() &&
+			fwrite(vertexSource.data(), 1, vertexSource.size(), file) == vertexSource.size() &&
+			fwrite(fragmentSource.data(), 1, fragmentSource.size(), file) == fragmentSource.size() &&
+			fwrite(binary.data(), 1, size_t(length), file) == size_t(length);
+		fclose(file);
+		std::error_code error;
+		if (written) std::filesystem::rename(tempPath, entryPath, error);
+		if (!written || error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	unsigned long long ShaderCache::GetKey(const std::string& vertexSource, const std::string& fragmentSource) const
+	{
+		std::string key;
+		key.reserve(driver.size() + vertexSource.size() + fragmentSource.size() + 2);
+		key += driver;
+		key += '\0';
+		key += vertexSource;
+		key += '\0';
+		key += fragmentSource;
+		return std::hash<std::string>()(key);
+	}
+
+	std::string ShaderCache::GetEntryPath(unsigned long long key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.slpb", key);
+		return (std::filesystem::path(directory) / name).string();
+	}
+}
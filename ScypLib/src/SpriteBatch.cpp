@@ -0,0 +1,339 @@
+#include<cassert>
+#include<cmath>
+#include<algorithm>
+
+#include<GL/glew.h>
+#include<glm/glm.hpp>
+
+#include"ScypLib/SpriteBatch.h"
+
+namespace sl
+{
+	SpriteBatch::SpriteBatch(size_t capacity)
+	{
+		positions.reserve(capacity);
+		sizes.reserve(capacity);
+		origins.reserve(capacity);
+		angles.reserve(capacity);
+		uvs.reserve(capacity);
+		colors.reserve(capacity);
+		textureIndices.reserve(capacity);
+		handles.reserve(capacity);
+		slots.reserve(capacity);
+	}
+
+	SpriteBatch::~SpriteBatch()
+	{
+		if (buffer) glDeleteBuffers(1, &buffer);
+	}
+
+	SpriteBatch::Handle SpriteBatch::Add(const Sprite& sprite)
+	{
+		assert(sprite.GetTexture() && "Failed to add sprite. Texture is nullptr");
+		unsigned int index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = unsigned int(slots.size());
+			slots.emplace_back();
+		}
+		unsigned int dense = unsigned int(positions.size());
+		slots[index].dense = dense;
+
+		positions.emplace_back();
+		sizes.emplace_back();
+		origins.emplace_back();
+		angles.emplace_back();
+		uvs.emplace_back(0.0f, 1.0f, 0.0f, 1.0f);
+		colors.emplace_back();
+		textureIndices.push_back(AcquireTexture(sprite.GetTexture()));
+		handles.push_back(index);
+		dirtyFlags.push_back(false);
+		Write(dense, sprite);
+		if (IsTranslucent(dense)) translucentCount++;
+		if (positions.size() == 1)
+		{
+			bounds = GetSpriteBounds(dense);
+			boundsDirty = false;
+		}
+		else GrowBounds(GetSpriteBounds(dense));
+		return Handle{ index, slots[index].generation };
+	}
+
+	void SpriteBatch::Update(Handle handle, const Sprite& sprite)
+	{
+		assert(sprite.GetTexture() && "Failed to update sprite. Texture is nullptr");
+		unsigned int dense = GetDense(handle);
+		if (IsTranslucent(dense)) translucentCount--;
+		unsigned short textureIndex = AcquireTexture(sprite.GetTexture());
+		ReleaseTexture(textureIndices[dense]);
+		textureIndices[dense] = textureIndex;
+		RectF previous = GetSpriteBounds(dense);
+		Write(dense, sprite);
+		if (IsTranslucent(dense)) translucentCount++;
+		MoveBounds(previous, dense);
+	}
+
+	void SpriteBatch::Remove(Handle handle)
+	{
+		unsigned int dense = GetDense(handle);
+		if (IsTranslucent(dense)) translucentCount--;
+		ReleaseTexture(textureIndices[dense]);
+		if (!boundsDirty)
+		{
+			RectF removed = GetSpriteBounds(dense);
+			boundsDirty = removed.left == bounds.left || removed.right == bounds.right || removed.top == bounds.top || removed.bottom == bounds.bottom;
+		}
+
+		//the last sprite fills the hole so the arrays stay packed, only its record has to be re-uploaded
+		unsigned int last = unsigned int(positions.size() - 1);
+		if (dense != last)
+		{
+			positions[dense] = positions[last];
+			sizes[dense] = sizes[last];
+			origins[dense] = origins[last];
+			angles[dense] = angles[last];
+			uvs[dense] = uvs[last];
+			colors[dense] = colors[last];
+			textureIndices[dense] = textureIndices[last];
+			handles[dense] = handles[last];
+			slots[handles[dense]].dense = dense;
+			MarkDirty(dense);
+		}
+		positions.pop_back();
+		sizes.pop_back();
+		origins.pop_back();
+		angles.pop_back();
+		uvs.pop_back();
+		colors.pop_back();
+		textureIndices.pop_back();
+		handles.pop_back();
+		dirtyFlags.pop_back();
+
+		slots[handle.index].dense = ~0u;
+		slots[handle.index].generation++;
+		freeSlots.push_back(handle.index);
+		if (positions.empty())
+		{
+			bounds = RectF(0.0f, 0.0f, 0.0f, 0.0f);
+			boundsDirty = false;
+		}
+	}
+
+	void SpriteBatch::Clear()
+	{
+		for (unsigned int index : handles)
+		{
+			slots[index].dense = ~0u;
+			slots[index].generation++;
+			freeSlots.push_back(index);
+		}
+		positions.clear();
+		sizes.clear();
+		origins.clear();
+		angles.clear();
+		uvs.clear();
+		colors.clear();
+		textureIndices.clear();
+		handles.clear();
+		textures.clear();
+		textureRefs.clear();
+		textureSlots.clear();
+		dirtyIndices.clear();
+		dirtyFlags.clear();
+		translucentCount = 0;
+		bounds = RectF(0.0f, 0.0f, 0.0f, 0.0f);
+		boundsDirty = false;
+	}
+
+	void SpriteBatch::SetPos(Handle handle, Vec2f pos)
+	{
+		unsigned int dense = GetDense(handle);
+		RectF previous = GetSpriteBounds(dense);
+		positions[dense] = pos;
+		MarkDirty(dense);
+		MoveBounds(previous, dense);
+	}
+
+	void SpriteBatch::SetRotation(Handle handle, float angle)
+	{
+		unsigned int dense = GetDense(handle);
+		RectF previous = GetSpriteBounds(dense);
+		angles[dense] = glm::radians(angle);
+		MarkDirty(dense);
+		MoveBounds(previous, dense);
+	}
+
+	void SpriteBatch::SetColorTint(Handle handle, const Color& tint)
+	{
+		unsigned int dense = GetDense(handle);
+		if (IsTranslucent(dense)) translucentCount--;
+		colors[dense] = tint;
+		if (IsTranslucent(dense)) translucentCount++;
+		MarkDirty(dense);
+	}
+
+	void SpriteBatch::SetNDCUV(Handle handle, const RectF& uv)
+	{
+		unsigned int dense = GetDense(handle);
+		uvs[dense] = uv;
+		MarkDirty(dense);
+	}
+
+	bool SpriteBatch::IsValid(Handle handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].generation == handle.generation && slots[handle.index].dense != ~0u;
+	}
+
+	Vec2f SpriteBatch::GetPos(Handle handle) const
+	{
+		return positions[GetDense(handle)];
+	}
+
+	RectF SpriteBatch::GetBounds()
+	{
+		if (!boundsDirty) return bounds;
+		boundsDirty = false;
+		if (positions.empty())
+		{
+			bounds = RectF(0.0f, 0.0f, 0.0f, 0.0f);
+			return bounds;
+		}
+		bounds = GetSpriteBounds(0);
+		for (unsigned int i = 1; i < unsigned int(positions.size()); i++) GrowBounds(GetSpriteBounds(i));
+		return bounds;
+	}
+
+	unsigned int SpriteBatch::GetDense(Handle handle) const
+	{
+		assert(IsValid(handle) && "Failed to access sprite. Handle is stale");
+		return slots[handle.index].dense;
+	}
+
+	unsigned short SpriteBatch::AcquireTexture(const Texture* texture)
+	{
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			if (textures[i] == texture)
+			{
+				textureRefs[i]++;
+				return static_cast<unsigned short>(i);
+			}
+		}
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			if (textureRefs[i] == 0)
+			{
+				textures[i] = texture;
+				textureRefs[i] = 1;
+				textureSlots[i] = -1;
+				return static_cast<unsigned short>(i);
+			}
+		}
+		assert(textures.size() < 0xFFFF);
+		textures.push_back(texture);
+		textureRefs.push_back(1);
+		textureSlots.push_back(-1);
+		return static_cast<unsigned short>(textures.size() - 1);
+	}
+
+	void SpriteBatch::ReleaseTexture(unsigned short index)
+	{
+		assert(textureRefs[index] > 0);
+		if (--textureRefs[index] == 0) textures[index] = nullptr;
+	}
+
+	void SpriteBatch::Write(unsigned int dense, const Sprite& sprite)
+	{
+		positions[dense] = sprite.GetPos();
+		sizes[dense] = sprite.GetSize();
+		origins[dense] = sprite.GetOrigin();
+		angles[dense] = glm::radians(sprite.GetRotation());
+		uvs[dense] = sprite.GetNDCUV();
+		colors[dense] = sprite.GetColorTint();
+		MarkDirty(dense);
+	}
+
+	RectF SpriteBatch::GetSpriteBounds(unsigned int dense) const
+	{
+		//same rotated box as the per renderable culling test
+		float halfWidth = std::abs(sizes[dense].x) / 2.0f;
+		float halfHeight = std::abs(sizes[dense].y) / 2.0f;
+		Vec2f center(positions[dense].x + sizes[dense].x / 2.0f, positions[dense].y + sizes[dense].y / 2.0f);
+		if (angles[dense] != 0.0f)
+		{
+			float s = std::sin(angles[dense]);
+			float c = std::cos(angles[dense]);
+			Vec2f pivot = positions[dense] + origins[dense];
+			Vec2f local = center - pivot;
+			center = pivot + Vec2f(c * local.x - s * local.y, s * local.x + c * local.y);
+			float rotatedHalfWidth = std::abs(c) * halfWidth + std::abs(s) * halfHeight;
+			float rotatedHalfHeight = std::abs(s) * halfWidth + std::abs(c) * halfHeight;
+			halfWidth = rotatedHalfWidth;
+			halfHeight = rotatedHalfHeight;
+		}
+		return RectF(center.x - halfWidth, center.x + halfWidth, center.y - halfHeight, center.y + halfHeight);
+	}
+
+	void SpriteBatch::GrowBounds(const RectF& box)
+	{
+		bounds.left = std::min(bounds.left, box.left);
+		bounds.right = std::max(bounds.right, box.right);
+		bounds.top = std::min(bounds.top, box.top);
+		bounds.bottom = std::max(bounds.bottom, box.bottom);
+	}
+
+	void SpriteBatch::MoveBounds(const RectF& previous, unsigned int dense)
+	{
+		if (boundsDirty) return;
+		RectF current = GetSpriteBounds(dense);
+		//a sprite that defined an edge and moved inward may leave the bounds too large, only that needs the full rebuild
+		if ((previous.left == bounds.left && current.left > previous.left) || (previous.right == bounds.right && current.right < previous.right) ||
+			(previous.top == bounds.top && current.top > previous.top) || (previous.bottom == bounds.bottom && current.bottom < previous.bottom))
+		{
+			boundsDirty = true;
+			return;
+		}
+		GrowBounds(current);
+	}
+
+	void SpriteBatch::MarkDirty(unsigned int dense)
+	{
+		if (dirtyFlags[dense]) return;
+		dirtyFlags[dense] = true;
+		dirtyIndices.push_back(dense);
+	}
+
+	void SpriteBatch::MarkTextureDirty(unsigned short textureIndex)
+	{
+		for (unsigned int i = 0; i < unsigned int(textureIndices.size()); i++)
+		{
+			if (textureIndices[i] == textureIndex) MarkDirty(i);
+		}
+	}
+
+	void SpriteBatch::MarkAllDirty()
+	{
+		for (unsigned int i = 0; i < unsigned int(positions.size()); i++) MarkDirty(i);
+	}
+
+	bool SpriteBatch::IsTranslucent(unsigned int dense) const
+	{
+		float alpha = colors[dense].a;
+		return !textures[textureIndices[dense]]->IsBinaryAlpha() || (alpha != 1.0f && alpha != 0.0f);
+	}
+
+	void SpriteBatch::Reserve(size_t instanceSize, size_t capacity)
+	{
+		if (capacity <= gpuCapacity) return;
+		gpuCapacity = std::max(capacity, gpuCapacity * 2);
+		if (buffer) glDeleteBuffers(1, &buffer);
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, GLsizeiptr(instanceSize * gpuCapacity), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		MarkAllDirty();
+	}
+}
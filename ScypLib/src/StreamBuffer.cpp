@@ -0,0 +1,82 @@
+#include<cassert>
+#include<stdexcept>
+
+#include"ScypLib/StreamBuffer.h"
+
+namespace sl
+{
+	StreamBuffer::StreamBuffer(size_t regionSize, int regionCount)
+		: regionSize(regionSize), regionCount(regionCount), fences(regionCount, nullptr)
+	{
+		assert(regionCount > 0 && regionSize > 0);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &handle);
+		glNamedBufferStorage(handle, GLsizeiptr(regionSize * regionCount), nullptr, flags);
+		mapped = (unsigned char*)glMapNamedBufferRange(handle, 0, GLsizeiptr(regionSize * regionCount), flags);
+		if (!mapped)
+		{
+			glDeleteBuffers(1, &handle);
+			throw std::runtime_error("Failed to map stream buffer");
+		}
+	}
+
+	StreamBuffer::~StreamBuffer()
+	{
+		for (GLsync fence : fences)
+		{
+			if (fence) glDeleteSync(fence);
+		}
+		glUnmapNamedBuffer(handle);
+		glDeleteBuffers(1, &handle);
+	}
+
+	void* StreamBuffer::Reserve(size_t size, size_t alignment, size_t& offset)
+	{
+		assert(size <= regionSize && "Reservation does not fit in a stream buffer region");
+		size_t regionStart = size_t(region) * regionSize;
+		size_t aligned = (regionStart + cursor + alignment - 1) / alignment * alignment - regionStart;
+		if (aligned + size > regionSize)
+		{
+			NextRegion();
+			regionStart = size_t(region) * regionSize;
+			aligned = (regionStart + alignment - 1) / alignment * alignment - regionStart;
+		}
+		cursor = aligned + size;
+		offset = regionStart + aligned;
+		return mapped + offset;
+	}
+
+	void StreamBuffer::EndFrame()
+	{
+		NextRegion();
+	}
+
+	bool StreamBuffer::IsSupported()
+	{
+		return GLEW_VERSION_4_5 || (GLEW_ARB_buffer_storage && GLEW_ARB_direct_state_access);
+	}
+
+	void StreamBuffer::NextRegion()
+	{
+		if (fences[region]) glDeleteSync(fences[region]);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region = (region + 1) % regionCount;
+		cursor = 0;
+
+		GLsync fence = fences[region];
+		if (fence)
+		{
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				stalls++;
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			fences[region] = nullptr;
+		}
+	}
+}
@@ -1,4 +1,6 @@
 #include<cassert>
+#include<cmath>
+#include<algorithm>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include"stb/stb_image.h"
@@ -7,9 +9,34 @@
 #include<GL/glew.h>
 
 #include"ScypLib/Texture.h"
+#include"ScypLib/TextureArray.h"
 
 namespace sl
 {
+	namespace
+	{
+		GLenum GetUploadFormat(int BPP)
+		{
+			if (BPP == 4) return GL_RGBA;
+			if (BPP == 3) return GL_RGB;
+			if (BPP == 2) return GL_RG;
+			return GL_RED;
+		}
+
+		//grey with alpha is uploaded as two channels and read back as grey, grey, grey, alpha
+		void SetGreyAlphaSwizzle(unsigned int handle, int BPP)
+		{
+			GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+			if (BPP == 2) swizzle[1] = swizzle[2] = GL_RED, swizzle[3] = GL_GREEN;
+			glTextureParameteriv(handle, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+
+		int GetMipLevelCount(int width, int height)
+		{
+			return 1 + int(std::floor(std::log2(float(std::max(width, height)))));
+		}
+	}
+
 	Texture::Texture(int width, int height, int BPP, unsigned char* buffer, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
 		: width(width), height(height), BPP(BPP)
 	{
@@ -25,42 +52,163 @@ namespace sl
 		stbi_image_free(buffer);
 	}
 
+	Texture::Texture(TextureArray* array, int layer, int BPP, const unsigned char* buffer)
+		: handle(array->GetHandle()), width(array->GetWidth()), height(array->GetHeight()), BPP(BPP), array(array), arrayLayer(layer)
+	{
+		array->Upload(layer, BPP, buffer);
+		ScanAlpha(buffer, size_t(width) * height);
+	}
+
+	Texture::Texture(int width, int height, const std::vector<const unsigned char*>& levels, bool binaryAlpha, bool opaque, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
+		: width(width), height(height), BPP(4), binaryAlpha(binaryAlpha), opaque(opaque)
+	{
+		assert(!levels.empty());
+		bool withMips = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+		//a chain cut short of 1x1 gets the rest built by the driver
+		int levelCount = withMips ? int(levels.size()) : 1;
+		Allocate(width, height, withMips ? GetMipLevelCount(width, height) : 1, wrap, minFilter, magFilter);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = 0; level < levelCount; level++)
+		{
+			glTextureSubImage2D(handle, level, 0, 0, std::max(1, width >> level), std::max(1, height >> level), GL_RGBA, GL_UNSIGNED_BYTE, levels[level]);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (withMips && levelCount < GetMipLevelCount(width, height)) glGenerateTextureMipmap(handle);
+	}
+
+	Texture::Texture(int width, int height, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
+		: width(width), height(height), BPP(4), ready(false)
+	{
+		//created through dsa only, async requests come in mid frame and must not disturb the slot bindings
+		unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		Allocate(1, 1, 1, wrap, minFilter, magFilter);
+		glTextureSubImage2D(handle, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	}
+
+	Texture::Texture(int width, int height, TextureFormat format)
+		: width(width), height(height), BPP(4), opaque(false)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+		glTextureStorage2D(handle, 1, GLenum(format), width, height);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	Texture::Texture(TextureAtlas* atlas, const Texture* page, const RectF& region, int width, int height, int BPP, const unsigned char* buffer)
+		: handle(page->GetHandle()), width(width), height(height), BPP(BPP), atlas(atlas), atlasPage(page), atlasRegion(region)
+	{
+		ScanAlpha(buffer, size_t(width) * height);
+	}
+
 	Texture::~Texture()
 	{
-		glDeleteTextures(1, &handle);
+		if (!array && !atlas) glDeleteTextures(1, &handle);
 	}
 
 	void Texture::Init(const unsigned char* buffer, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
 	{
-		glGenTextures(1, &handle);
-		glBindTexture(GL_TEXTURE_2D, handle);
+		//glyph pages are created inside DrawText, binding here would change a unit under the slot lru
+		bool withMips = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+		Allocate(width, height, withMips ? GetMipLevelCount(width, height) : 1, wrap, minFilter, magFilter);
+		if (buffer)
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTextureSubImage2D(handle, 0, 0, 0, width, height, GetUploadFormat(BPP), GL_UNSIGNED_BYTE, buffer);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			SetGreyAlphaSwizzle(handle, BPP);
+			if (mipmapped) glGenerateTextureMipmap(handle);
+		}
+		ScanAlpha(buffer, size_t(width) * height);
+	}
+
+	void Texture::Update(int x, int y, int width, int height, int BPP, const unsigned char* buffer)
+	{
+		assert(!array && !atlas && buffer);
+		GLenum format = GetUploadFormat(BPP);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(handle, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, buffer);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (BPP == 4 && (binaryAlpha || opaque)) ScanAlpha(buffer, size_t(width) * height);
+	}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, unsigned int(minFilter));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, unsigned int(magFilter));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, unsigned int(wrap));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, unsigned int(wrap));
+	void Texture::Store(int width, int height, int BPP, const void* pixels, bool binaryAlpha, bool opaque)
+	{
+		assert(!array && !atlas);
+		Reallocate(width, height, mipmapped ? GetMipLevelCount(width, height) : 1);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(handle, 0, 0, 0, width, height, GetUploadFormat(BPP), GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		SetGreyAlphaSwizzle(handle, BPP);
+		if (mipmapped) glGenerateTextureMipmap(handle);
+		this->width = width;
+		this->height = height;
+		this->BPP = BPP;
+		this->binaryAlpha = binaryAlpha;
+		this->opaque = opaque;
+		ready = true;
+	}
 
-		if (BPP == 4) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)buffer);
-		else if (BPP == 3) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (const void*)buffer);
-		else if (BPP == 1) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, (const void*)buffer);
-		if (minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
-			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear)
+	void Texture::Store(int width, int height, const std::vector<const unsigned char*>& levels, bool binaryAlpha, bool opaque)
+	{
+		assert(!array && !atlas && !levels.empty());
+		if (!mipmapped || levels.size() == 1)
+		{
+			Store(width, height, 4, levels[0], binaryAlpha, opaque);
+			return;
+		}
+		Reallocate(width, height, int(levels.size()));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = 0; level < int(levels.size()); level++)
 		{
-			glGenerateMipmap(GL_TEXTURE_2D);
+			glTextureSubImage2D(handle, level, 0, 0, std::max(1, width >> level), std::max(1, height >> level), GL_RGBA, GL_UNSIGNED_BYTE, levels[level]);
 		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		this->width = width;
+		this->height = height;
+		BPP = 4;
+		this->binaryAlpha = binaryAlpha;
+		this->opaque = opaque;
+		ready = true;
+	}
+
+	void Texture::Allocate(int width, int height, int levelCount, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, unsigned int(minFilter));
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, unsigned int(magFilter));
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, unsigned int(wrap));
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, unsigned int(wrap));
+		glTextureStorage2D(handle, levelCount, GL_RGBA8, width, height);
+		mipmapped = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+	}
+
+	void Texture::Reallocate(int width, int height, int levelCount)
+	{
+		//immutable storage cannot be resized, a new texture with the same sampling takes over and Graphics rebinds its slot
+		int wrap = 0, minFilter = 0, magFilter = 0;
+		glGetTextureParameteriv(handle, GL_TEXTURE_WRAP_S, &wrap);
+		glGetTextureParameteriv(handle, GL_TEXTURE_MIN_FILTER, &minFilter);
+		glGetTextureParameteriv(handle, GL_TEXTURE_MAG_FILTER, &magFilter);
+		glDeleteTextures(1, &handle);
+		Allocate(width, height, levelCount, TextureWrap(wrap), TextureFilter(minFilter), TextureFilter(magFilter));
+	}
 
-		if (BPP == 4)
+	void Texture::ScanAlpha(const unsigned char* buffer, size_t pixelCount)
+	{
+		//grey with alpha keeps alpha in its second byte
+		if ((BPP == 4 || BPP == 2) && !buffer) opaque = false;
+		else if (BPP == 4 || BPP == 2)
 		{
+			for (size_t i = 0; i < pixelCount * BPP && (binaryAlpha || opaque); i += BPP)
 			{
-				for (int i = 0; i < width * height * 4; i += 4)
-				{
-					unsigned char alpha = buffer[i + 3];
-					if (alpha != 0 && alpha != 255)
-					{
-						binaryAlpha = false;
-						break;
-					}
-				}
+				unsigned char alpha = buffer[i + BPP - 1];
+				if (alpha != 255) opaque = false;
+				if (alpha != 0 && alpha != 255) binaryAlpha = false;
 			}
 		}
 	}
@@ -0,0 +1,73 @@
+#include<cassert>
+#include<cmath>
+#include<algorithm>
+
+#include<GL/glew.h>
+
+#include"ScypLib/TextureArray.h"
+
+namespace sl
+{
+	TextureArray::TextureArray(int width, int height, int layers, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter)
+		: width(width), height(height), layers(layers), wrap(wrap), minFilter(minFilter), magFilter(magFilter)
+	{
+		mipmapped = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+		int levels = mipmapped ? 1 + int(std::floor(std::log2(float(std::max(width, height))))) : 1;
+
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &handle);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, unsigned int(minFilter));
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, unsigned int(magFilter));
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, unsigned int(wrap));
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, unsigned int(wrap));
+		glTextureStorage3D(handle, levels, GL_RGBA8, width, height, layers);
+
+		freeLayers.reserve(layers);
+		for (int i = layers - 1; i >= 0; i--) freeLayers.push_back(i);
+	}
+
+	TextureArray::~TextureArray()
+	{
+		glDeleteTextures(1, &handle);
+	}
+
+	int TextureArray::AllocateLayer()
+	{
+		if (freeLayers.empty()) return -1;
+		int layer = freeLayers.back();
+		freeLayers.pop_back();
+		return layer;
+	}
+
+	void TextureArray::FreeLayer(int layer)
+	{
+		assert(layer >= 0 && layer < layers);
+		freeLayers.push_back(layer);
+	}
+
+	void TextureArray::Upload(int layer, int BPP, const unsigned char* buffer)
+	{
+		assert(layer >= 0 && layer < layers);
+		assert((BPP == 1 || BPP == 3 || BPP == 4) && "Failed to upload layer. BPP must be 1, 3 or 4");
+		GLenum format = GL_RGBA;
+		if (BPP == 3) format = GL_RGB;
+		else if (BPP == 1) format = GL_RED;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage3D(handle, 0, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE, buffer);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		mipmapsDirty = mipmapped;
+	}
+
+	void TextureArray::UpdateMipmaps()
+	{
+		if (!mipmapsDirty) return;
+		glGenerateTextureMipmap(handle);
+		mipmapsDirty = false;
+	}
+
+	bool TextureArray::IsCompatible(int width, int height, TextureWrap wrap, TextureFilter minFilter, TextureFilter magFilter) const
+	{
+		return this->width == width && this->height == height && this->wrap == wrap &&
+			this->minFilter == minFilter && this->magFilter == magFilter;
+	}
+}
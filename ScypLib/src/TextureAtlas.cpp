@@ -0,0 +1,270 @@
+#include<cassert>
+#include<algorithm>
+#include<climits>
+
+#include<GL/glew.h>
+
+#include"ScypLib/TextureAtlas.h"
+
+namespace sl
+{
+	TextureAtlas::TextureAtlas(int pageSize, int padding, TextureFilter minFilter, TextureFilter magFilter)
+		: pageSize(pageSize), padding(padding), minFilter(minFilter), magFilter(magFilter)
+	{
+		mipmapped = minFilter == TextureFilter::NearestMipmapLinear || minFilter == TextureFilter::NearestMipmapNearest ||
+			minFilter == TextureFilter::LinearMipmapNearest || minFilter == TextureFilter::LinearMipmapLinear;
+	}
+
+	Texture* TextureAtlas::Add(const std::string& name, int width, int height, int BPP, const unsigned char* buffer)
+	{
+		assert(buffer && "Failed to add texture to atlas. Buffer is nullptr");
+		assert(BPP >= 1 && BPP <= 4 && "Failed to add texture to atlas. Unsupported channel count");
+		if (Texture* existing = Find(name)) return existing;
+
+		int page, x, y;
+		if (!Place(width, height, page, x, y)) return nullptr;
+
+		Entry entry;
+		entry.name = name;
+		entry.page = page;
+		entry.x = x;
+		entry.y = y;
+		entry.texture = std::make_unique<Texture>(this, pages[page].texture.get(), GetRegion(x, y, width, height), width, height, BPP, buffer);
+		Upload(entry, width, height, BPP, buffer);
+
+		Texture* rawPtr = entry.texture.get();
+		names[name] = rawPtr;
+		entries[rawPtr] = std::move(entry);
+		return rawPtr;
+	}
+
+	void TextureAtlas::Remove(Texture* texture)
+	{
+		auto it = entries.find(texture);
+		assert(it != entries.end() && "Failed to remove texture. Texture is not in this atlas");
+		//skyline space is not reclaimed, the hole counts as fragmentation until the next repack
+		usedArea -= size_t(texture->GetWidth() + 2 * padding) * (texture->GetHeight() + 2 * padding);
+		names.erase(it->second.name);
+		entries.erase(it);
+	}
+
+	Texture* TextureAtlas::Find(const std::string& name) const
+	{
+		auto it = names.find(name);
+		return it == names.end() ? nullptr : it->second;
+	}
+
+	float TextureAtlas::GetFragmentation() const
+	{
+		if (packedArea == 0) return 0.0f;
+		return 1.0f - float(usedArea) / float(packedArea);
+	}
+
+	std::vector<std::unique_ptr<Texture>> TextureAtlas::Repack()
+	{
+		//read the live images back before their pages go away
+		struct Pending
+		{
+			Entry* entry;
+			std::vector<unsigned char> pixels;
+		};
+		std::vector<Pending> pending;
+		pending.reserve(entries.size());
+		for (auto& [texture, entry] : entries)
+		{
+			int width = texture->GetWidth();
+			int height = texture->GetHeight();
+			Pending image{ &entry, std::vector<unsigned char>(size_t(width) * height * 4) };
+			glGetTextureSubImage(pages[entry.page].texture->GetHandle(), 0, entry.x, entry.y, 0, width, height, 1,
+				GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(image.pixels.size()), image.pixels.data());
+			pending.push_back(std::move(image));
+		}
+
+		std::vector<std::unique_ptr<Texture>> retired;
+		for (Page& page : pages) retired.push_back(std::move(page.texture));
+		pages.clear();
+		usedArea = 0;
+		packedArea = 0;
+
+		//tallest first keeps the skyline flat
+		std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b)
+			{
+				return a.entry->texture->GetHeight() > b.entry->texture->GetHeight();
+			});
+		for (Pending& image : pending)
+		{
+			Entry& entry = *image.entry;
+			Texture* texture = entry.texture.get();
+			int width = texture->GetWidth();
+			int height = texture->GetHeight();
+			bool placed = Place(width, height, entry.page, entry.x, entry.y);
+			assert(placed);
+			texture->handle = pages[entry.page].texture->GetHandle();
+			texture->atlasPage = pages[entry.page].texture.get();
+			texture->atlasRegion = GetRegion(entry.x, entry.y, width, height);
+			Upload(entry, width, height, 4, image.pixels.data());
+		}
+		return retired;
+	}
+
+	bool TextureAtlas::Place(int width, int height, int& page, int& x, int& y)
+	{
+		int paddedWidth = width + 2 * padding;
+		int paddedHeight = height + 2 * padding;
+		if (paddedWidth > pageSize || paddedHeight > pageSize) return false;
+
+		size_t node = 0;
+		page = -1;
+		for (int i = 0; i < int(pages.size()) && page == -1; i++)
+		{
+			if (FindPosition(pages[i], paddedWidth, paddedHeight, x, y, node)) page = i;
+		}
+		if (page == -1)
+		{
+			page = AddPage();
+			bool found = FindPosition(pages[page], paddedWidth, paddedHeight, x, y, node);
+			assert(found);
+		}
+		Insert(pages[page], node, x, y, paddedWidth, paddedHeight);
+		x += padding;
+		y += padding;
+		size_t area = size_t(paddedWidth) * paddedHeight;
+		usedArea += area;
+		packedArea += area;
+		return true;
+	}
+
+	bool TextureAtlas::FindPosition(const Page& page, int width, int height, int& x, int& y, size_t& node) const
+	{
+		//bottom left rule, lowest resulting top edge wins, narrower nodes break ties
+		int bestBottom = INT_MAX;
+		int bestWidth = INT_MAX;
+		bool found = false;
+		for (size_t i = 0; i < page.skyline.size(); i++)
+		{
+			int fitY = Fit(page, i, width, height);
+			if (fitY < 0) continue;
+			int bottom = fitY + height;
+			if (bottom < bestBottom || (bottom == bestBottom && page.skyline[i].width < bestWidth))
+			{
+				bestBottom = bottom;
+				bestWidth = page.skyline[i].width;
+				x = page.skyline[i].x;
+				y = fitY;
+				node = i;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	int TextureAtlas::Fit(const Page& page, size_t node, int width, int height) const
+	{
+		int x = page.skyline[node].x;
+		if (x + width > pageSize) return -1;
+		int y = page.skyline[node].y;
+		int widthLeft = width;
+		for (size_t i = node; widthLeft > 0; i++)
+		{
+			if (i == page.skyline.size()) return -1;
+			y = std::max(y, page.skyline[i].y);
+			if (y + height > pageSize) return -1;
+			widthLeft -= page.skyline[i].width;
+		}
+		return y;
+	}
+
+	void TextureAtlas::Insert(Page& page, size_t node, int x, int y, int width, int height)
+	{
+		std::vector<SkylineNode>& skyline = page.skyline;
+		skyline.insert(skyline.begin() + node, SkylineNode{ x, y + height, width });
+		//trim the nodes now covered by the new one
+		for (size_t i = node + 1; i < skyline.size();)
+		{
+			int previousRight = skyline[i - 1].x + skyline[i - 1].width;
+			if (skyline[i].x >= previousRight) break;
+			int shrink = previousRight - skyline[i].x;
+			skyline[i].x += shrink;
+			skyline[i].width -= shrink;
+			if (skyline[i].width > 0) break;
+			skyline.erase(skyline.begin() + i);
+		}
+		for (size_t i = 0; i + 1 < skyline.size();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else i++;
+		}
+	}
+
+	int TextureAtlas::AddPage()
+	{
+		Page page;
+		page.texture = std::make_unique<Texture>(pageSize, pageSize, 4, nullptr, TextureWrap::ClampToEdge, minFilter, magFilter);
+		glClearTexImage(page.texture->GetHandle(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		page.skyline.push_back(SkylineNode{ 0, 0, pageSize });
+		pages.push_back(std::move(page));
+		return int(pages.size() - 1);
+	}
+
+	void TextureAtlas::Upload(const Entry& entry, int width, int height, int BPP, const unsigned char* buffer)
+	{
+		//expand to rgba and extrude the border, every padded pixel repeats the closest edge pixel
+		int paddedWidth = width + 2 * padding;
+		int paddedHeight = height + 2 * padding;
+		uploadBuffer.resize(size_t(paddedWidth) * paddedHeight * 4);
+		for (int py = 0; py < paddedHeight; py++)
+		{
+			int sy = std::clamp(py - padding, 0, height - 1);
+			for (int px = 0; px < paddedWidth; px++)
+			{
+				int sx = std::clamp(px - padding, 0, width - 1);
+				const unsigned char* src = buffer + (size_t(sy) * width + sx) * BPP;
+				unsigned char* dst = &uploadBuffer[(size_t(py) * paddedWidth + px) * 4];
+				if (BPP == 1)
+				{
+					dst[0] = src[0];
+					dst[1] = 0;
+					dst[2] = 0;
+					dst[3] = 255;
+				}
+				else if (BPP == 2)
+				{
+					dst[0] = src[0];
+					dst[1] = src[0];
+					dst[2] = src[0];
+					dst[3] = src[1];
+				}
+				else
+				{
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+					dst[3] = BPP == 4 ? src[3] : 255;
+				}
+			}
+		}
+		Texture* page = pages[entry.page].texture.get();
+		page->Update(entry.x - padding, entry.y - padding, paddedWidth, paddedHeight, 4, uploadBuffer.data());
+		pages[entry.page].mipmapsDirty = mipmapped;
+	}
+
+	void TextureAtlas::UpdateMipmaps()
+	{
+		for (Page& page : pages)
+		{
+			if (!page.mipmapsDirty) continue;
+			glGenerateTextureMipmap(page.texture->GetHandle());
+			page.mipmapsDirty = false;
+		}
+	}
+
+	RectF TextureAtlas::GetRegion(int x, int y, int width, int height) const
+	{
+		float size = float(pageSize);
+		return RectF(x / size, (x + width) / size, y / size, (y + height) / size);
+	}
+}
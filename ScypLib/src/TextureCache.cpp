@@ -0,0 +1,198 @@
+#include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<algorithm>
+#include<filesystem>
+#include<functional>
+#include<thread>
+
+#include"ScypLib/TextureCache.h"
+
+namespace sl
+{
+	namespace
+	{
+		constexpr uint32_t cacheMagic = 0x43544C53;//"SLTC"
+		constexpr uint32_t cacheVersion = 2;
+
+		struct CacheHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			uint32_t width;
+			uint32_t height;
+			uint32_t levels;
+			uint32_t binaryAlpha;
+			uint32_t pathLength;//source path follows the header, padded to 4 bytes, then the levels
+			uint32_t opaque;
+		};
+
+		size_t LevelSize(uint32_t width, uint32_t height, uint32_t level)
+		{
+			return size_t(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4;
+		}
+	}
+
+	TextureCache::TextureCache(const std::string& directory)
+		: directory(directory)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+	}
+
+	bool TextureCache::Load(const std::string& sourcePath, bool withMips, Image& image)
+	{
+		bool hit = Read(sourcePath, withMips, image);
+		if (hit) hits++;
+		else misses++;
+		return hit;
+	}
+
+	bool TextureCache::Read(const std::string& sourcePath, bool withMips, Image& image)
+	{
+		unsigned long long sourceSize;
+		long long sourceTime;
+		if (!GetSourceStamp(sourcePath, sourceSize, sourceTime) || !image.file.Open(GetEntryPath(sourcePath))) return false;
+
+		const unsigned char* data = image.file.GetData();
+		size_t fileSize = image.file.GetSize();
+		CacheHeader header;
+		bool valid = fileSize >= sizeof(header);
+		if (valid)
+		{
+			memcpy(&header, data, sizeof(header));
+			valid = header.magic == cacheMagic && header.version == cacheVersion && header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+				header.pathLength == sourcePath.size() && fileSize >= sizeof(header) + header.pathLength &&
+				memcmp(data + sizeof(header), sourcePath.data(), sourcePath.size()) == 0 && (!withMips || header.levels > 1);
+		}
+		size_t offset = sizeof(header) + ((size_t(valid ? header.pathLength : 0) + 3) & ~size_t(3));
+		image.levels.clear();
+		for (uint32_t level = 0; valid && level < header.levels; level++)
+		{
+			size_t levelSize = LevelSize(header.width, header.height, level);
+			if (offset + levelSize > fileSize)
+			{
+				valid = false;
+				break;
+			}
+			image.levels.push_back(data + offset);
+			offset += levelSize;
+		}
+		if (!valid)
+		{
+			image.file.Close();
+			image.levels.clear();
+			return false;
+		}
+		image.width = int(header.width);
+		image.height = int(header.height);
+		image.binaryAlpha = header.binaryAlpha != 0;
+		image.opaque = header.opaque != 0;
+		return true;
+	}
+
+	bool TextureCache::Save(const std::string& sourcePath, int width, int height, int BPP, const unsigned char* pixels, bool withMips, Image* image)
+	{
+		unsigned long long sourceSize;
+		long long sourceTime;
+		if (!GetSourceStamp(sourcePath, sourceSize, sourceTime)) return false;
+
+		std::vector<std::vector<unsigned char>> levels(1);
+		std::vector<unsigned char>& base = levels[0];
+		base.resize(size_t(width) * height * 4);
+		bool binaryAlpha = true;
+		bool opaque = true;
+		for (size_t i = 0; i < size_t(width) * height; i++)
+		{
+			//same texels the uncached upload shows, grey with alpha is swizzled to grey and grey alone lands in red
+			const unsigned char* src = pixels + i * BPP;
+			unsigned char* dst = &base[i * 4];
+			dst[0] = src[0];
+			dst[1] = BPP >= 3 ? src[1] : BPP == 2 ? src[0] : 0;
+			dst[2] = BPP >= 3 ? src[2] : BPP == 2 ? src[0] : 0;
+			dst[3] = BPP == 4 ? src[3] : BPP == 2 ? src[1] : 255;
+			if (dst[3] != 255) opaque = false;
+			if (dst[3] != 0 && dst[3] != 255) binaryAlpha = false;
+		}
+		//2x2 box filter, odd edges reuse the last row or column
+		int levelWidth = width, levelHeight = height;
+		while (withMips && (levelWidth > 1 || levelHeight > 1))
+		{
+			int nextWidth = std::max(1, levelWidth / 2);
+			int nextHeight = std::max(1, levelHeight / 2);
+			const std::vector<unsigned char>& previous = levels.back();
+			std::vector<unsigned char> next(size_t(nextWidth) * nextHeight * 4);
+			for (int y = 0; y < nextHeight; y++)
+			{
+				int y0 = std::min(y * 2, levelHeight - 1), y1 = std::min(y * 2 + 1, levelHeight - 1);
+				for (int x = 0; x < nextWidth; x++)
+				{
+					int x0 = std::min(x * 2, levelWidth - 1), x1 = std::min(x * 2 + 1, levelWidth - 1);
+					for (int c = 0; c < 4; c++)
+					{
+						int sum = previous[(size_t(y0) * levelWidth + x0) * 4 + c] + previous[(size_t(y0) * levelWidth + x1) * 4 + c] +
+							previous[(size_t(y1) * levelWidth + x0) * 4 + c] + previous[(size_t(y1) * levelWidth + x1) * 4 + c];
+						next[(size_t(y) * nextWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+			levels.push_back(std::move(next));
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		CacheHeader header{};
+		header.magic = cacheMagic;
+		header.version = cacheVersion;
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		header.width = uint32_t(width);
+		header.height = uint32_t(height);
+		header.levels = uint32_t(levels.size());
+		header.binaryAlpha = binaryAlpha ? 1 : 0;
+		header.opaque = opaque ? 1 : 0;
+		header.pathLength = uint32_t(sourcePath.size());
+
+		//written next to the entry and renamed so readers never map a half written file
+		std::string entryPath = GetEntryPath(sourcePath);
+		std::string tempPath = entryPath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		FILE* file = nullptr;
+		errno_t err = fopen_s(&file, tempPath.c_str(), "wb");
+		if (err != 0 || !file) return false;
+		const unsigned char zeros[4] = {};
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(sourcePath.data(), 1, sourcePath.size(), file) == sourcePath.size() &&
+			fwrite(zeros, 1, ((sourcePath.size() + 3) & ~size_t(3)) - sourcePath.size(), file) == ((sourcePath.size() + 3) & ~size_t(3)) - sourcePath.size();
+		for (const std::vector<unsigned char>& level : levels)
+		{
+			written = written && fwrite(level.data(), 1, level.size(), file) == level.size();
+		}
+		fclose(file);
+		std::error_code error;
+		if (written) std::filesystem::rename(tempPath, entryPath, error);
+		if (!written || error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return !image || Read(sourcePath, withMips, *image);
+	}
+
+	std::string TextureCache::GetEntryPath(const std::string& sourcePath) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.sltc", (unsigned long long)std::hash<std::string>()(sourcePath));
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	bool TextureCache::GetSourceStamp(const std::string& sourcePath, unsigned long long& size, long long& time)
+	{
+		std::error_code error;
+		size = std::filesystem::file_size(sourcePath, error);
+		if (error) return false;
+		time = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+		return !error;
+	}
+}
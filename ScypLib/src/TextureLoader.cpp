@@ -0,0 +1,115 @@
+#include<cstring>
+
+#include"stb/stb_image.h"
+
+#include"ScypLib/TextureLoader.h"
+
+namespace sl
+{
+	TextureLoader::TextureLoader(int threadCount)
+	{
+		if (threadCount < 1) threadCount = 1;
+		workers.reserve(threadCount);
+		for (int i = 0; i < threadCount; i++) workers.emplace_back(&TextureLoader::WorkerLoop, this);
+	}
+
+	TextureLoader::~TextureLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			stopping = true;
+			jobs.clear();
+		}
+		jobCondition.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	void TextureLoader::Enqueue(unsigned long long id, const std::string& path, bool flipVertically, TextureCache* cache, bool withMips, const AssetPack* pack)
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			jobs.push_back(Job{ id, path, flipVertically, cache, withMips, pack });
+		}
+		jobCondition.notify_one();
+	}
+
+	bool TextureLoader::PopResult(Result& result)
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		if (results.empty()) return false;
+		result = std::move(results.front());
+		results.pop_front();
+		return true;
+	}
+
+	size_t TextureLoader::PeekResultSize()
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		return results.empty() ? 0 : results.front().GetSize();
+	}
+
+	void TextureLoader::WorkerLoop()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(jobMutex);
+				jobCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			Result result;
+			result.id = job.id;
+			result.path = std::move(job.path);
+			if (job.cache && job.cache->Load(result.path, job.withMips, result.cached))
+			{
+				result.width = result.cached.width;
+				result.height = result.cached.height;
+				result.BPP = 4;
+				result.binaryAlpha = result.cached.binaryAlpha;
+				result.opaque = result.cached.opaque;
+			}
+			else
+			{
+				//the thread local flag leaves the process wide one used by synchronous loads untouched
+				stbi_set_flip_vertically_on_load_thread(job.flip ? 1 : 0);
+				AssetPack::Asset asset;
+				unsigned char* buffer = job.pack && job.pack->Read(result.path, asset) ?
+					stbi_load_from_memory(asset.GetData(), int(asset.GetSize()), &result.width, &result.height, &result.BPP, 0) :
+					stbi_load(result.path.c_str(), &result.width, &result.height, &result.BPP, 0);
+				if (buffer)
+				{
+					result.pixels.assign(buffer, buffer + size_t(result.width) * result.height * result.BPP);
+					stbi_image_free(buffer);
+					ScanAlpha(result.pixels, result.BPP, result.binaryAlpha, result.opaque);
+					//the mapped entry carries the box filtered chain, uploading it spares the gpu a mip build
+					if (job.cache && job.cache->Save(result.path, result.width, result.height, result.BPP, result.pixels.data(), job.withMips, &result.cached))
+					{
+						result.pixels.clear();
+						result.BPP = 4;
+						result.binaryAlpha = result.cached.binaryAlpha;
+						result.opaque = result.cached.opaque;
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(resultMutex);
+			results.push_back(std::move(result));
+		}
+	}
+
+	void TextureLoader::ScanAlpha(const std::vector<unsigned char>& pixels, int BPP, bool& binaryAlpha, bool& opaque)
+	{
+		binaryAlpha = true;
+		opaque = true;
+		if (BPP != 4 && BPP != 2) return;
+		for (size_t i = BPP - 1; i < pixels.size() && binaryAlpha; i += BPP)
+		{
+			if (pixels[i] != 255) opaque = false;
+			if (pixels[i] != 0 && pixels[i] != 255) binaryAlpha = false;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#include<cassert>
+#include<algorithm>
+
+#include<GL/glew.h>
+
+#include"ScypLib/Tilemap.h"
+
+namespace sl
+{
+	Tilemap::Tilemap(const Texture* atlas, int tileWidth, int tileHeight, int width, int height, int chunkSize)
+		: atlas(atlas), tileWidth(tileWidth), tileHeight(tileHeight), width(width), height(height), chunkSize(chunkSize),
+		tileSize(float(tileWidth), float(tileHeight))
+	{
+		assert(atlas && "Failed to create tilemap. Atlas is nullptr");
+		assert(tileWidth > 0 && tileHeight > 0 && width > 0 && height > 0 && chunkSize > 0);
+		atlasColumns = std::max(1, atlas->GetWidth() / tileWidth);
+		chunksX = (width + chunkSize - 1) / chunkSize;
+		chunksY = (height + chunkSize - 1) / chunkSize;
+		tiles.resize(size_t(width) * height, -1);
+		chunks.resize(size_t(chunksX) * chunksY);
+	}
+
+	Tilemap::~Tilemap()
+	{
+		for (Chunk& chunk : chunks)
+		{
+			if (chunk.buffer) glDeleteBuffers(1, &chunk.buffer);
+		}
+	}
+
+	void Tilemap::SetTile(int x, int y, int tile)
+	{
+		assert(x >= 0 && x < width && y >= 0 && y < height);
+		int& current = tiles[size_t(y) * width + x];
+		if (current == tile) return;
+		Chunk& chunk = chunks[size_t(y / chunkSize) * chunksX + x / chunkSize];
+		if (current < 0) chunk.tileCount++;
+		if (tile < 0) chunk.tileCount--;
+		current = tile < 0 ? -1 : tile;
+		chunk.dirty = true;
+	}
+
+	void Tilemap::Fill(int tile)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++) SetTile(x, y, tile);
+		}
+	}
+
+	void Tilemap::SetPosition(Vec2f position)
+	{
+		this->position = position;
+		MarkAllDirty();
+	}
+
+	void Tilemap::SetTileSize(Vec2f size)
+	{
+		tileSize = size;
+		MarkAllDirty();
+	}
+
+	int Tilemap::GetTile(int x, int y) const
+	{
+		assert(x >= 0 && x < width && y >= 0 && y < height);
+		return tiles[size_t(y) * width + x];
+	}
+
+	RectF Tilemap::GetTileUV(int tile) const
+	{
+		float left = float((tile % atlasColumns) * tileWidth);
+		float top = float((tile / atlasColumns) * tileHeight);
+		return RectF(left, left + tileWidth, top, top + tileHeight) / Vec2f(float(atlas->GetWidth()), float(atlas->GetHeight()));
+	}
+
+	RectF Tilemap::GetChunkRect(int chunkX, int chunkY) const
+	{
+		int columns = std::min(chunkSize, width - chunkX * chunkSize);
+		int rows = std::min(chunkSize, height - chunkY * chunkSize);
+		Vec2f topLeft(position.x + chunkX * chunkSize * tileSize.x, position.y + chunkY * chunkSize * tileSize.y);
+		return RectF(topLeft, columns * tileSize.x, rows * tileSize.y);
+	}
+
+	void Tilemap::MarkAllDirty()
+	{
+		for (Chunk& chunk : chunks) chunk.dirty = true;
+	}
+
+	void Tilemap::UploadChunk(Chunk& chunk, const void* instances, size_t instanceSize, unsigned int instanceCount)
+	{
+		//immutable storage cannot be resized, a rebuild replaces the buffer
+		if (chunk.buffer) glDeleteBuffers(1, &chunk.buffer);
+		chunk.buffer = 0;
+		chunk.instanceCount = instanceCount;
+		chunk.dirty = false;
+		if (instanceCount == 0) return;
+		glCreateBuffers(1, &chunk.buffer);
+		glNamedBufferStorage(chunk.buffer, GLsizeiptr(instanceSize * instanceCount), instances, 0);
+	}
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <ScypLib/AssetPack.h>
+
+// Offline packer: packer <output.pack> [--align N] [--store] <file or directory>...
+// Entries are named by the path given on the command line, so run it from the
+// directory the game loads its assets from and pass the same relative paths.
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: %s <output.pack> [--align N] [--store] <file or directory>...\n", argv[0]);
+        return 1;
+    }
+
+    size_t alignment = 16;
+    bool compress = true;
+    std::vector<sl::AssetPack::Source> sources;
+    auto add = [&](const std::filesystem::path& path)
+    {
+        // formats that are already compressed are stored raw, inflating them again would only cost load time
+        std::string extension = path.extension().string();
+        bool packed = extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".ogg" || extension == ".mp3" || extension == ".flac";
+        sources.push_back({ path.string(), path.generic_string(), alignment, compress && !packed });
+    };
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--align" && i + 1 < argc) alignment = size_t(std::strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--store") compress = false;
+        else if (std::filesystem::is_directory(arg))
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(arg))
+            {
+                if (entry.is_regular_file()) add(entry.path());
+            }
+        }
+        else add(arg);
+    }
+
+    if (!sl::AssetPack::Build(argv[1], sources))
+    {
+        printf("Failed to build %s\n", argv[1]);
+        return 1;
+    }
+    printf("Packed %zu files into %s\n", sources.size(), argv[1]);
+    return 0;
+}